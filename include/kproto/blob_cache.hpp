@@ -0,0 +1,496 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "hash.hpp"
+#include "ipc.hpp"
+
+namespace kiq {
+/**
+            ┌───────────────────────────────────────────────┐
+            │░░░░░░░░░░░░ CONTENT ADDRESSED BODIES ░░░░░░░░░│
+            │░░  1. Receiver caches large bodies, acks hash ░│
+            │░░  2. Sender replaces acked bodies with hash  ░│
+            │░░     and appends a manifest frame            ░│
+            │░░  3. Receiver resolves, or requests misses   ░│
+            │░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░│
+            └───────────────────────────────────────────────┘
+  Manifest frame: MANIFEST_MAGIC | u8 frame index * n. Each referenced frame
+  carries the 16 byte hash of its body instead of the body.
+
+  A blob_sender/blob_receiver pair belongs to one peer connection; the sender
+  only references bodies that this particular receiver has acknowledged.
+ */
+namespace blob {
+static const uint8_t MANIFEST_MAGIC[4]{0x00, 'K', 'R', 'F'};
+static const size_t  MIN_SIZE         {1024};
+static const size_t  MAX_BYTES        {64 * 1024 * 1024};
+static const size_t  MAX_PENDING      {1024};
+static const auto    PENDING_TIMEOUT  {std::chrono::milliseconds(30000)};
+//---------------------------------------------------------------------
+// Frames eligible for referencing, by message type
+inline const std::vector<uint8_t>& frames_for(uint8_t type)
+{
+  static const std::vector<uint8_t> none;
+  static const std::vector<uint8_t> platform{constants::index::DATA, constants::index::URLS};
+  static const std::vector<uint8_t> info    {constants::index::INFO};
+  static const std::vector<uint8_t> kiq     {constants::index::KIQ_DATA};
+  static const std::vector<uint8_t> request {constants::index::DATA};
+  switch (type)
+  {
+    case (constants::IPC_PLATFORM_TYPE):    return platform;
+    case (constants::IPC_PLATFORM_INFO):    return info;
+    case (constants::IPC_KIQ_MESSAGE):      return kiq;
+    case (constants::IPC_PLATFORM_REQUEST): return request;
+    default:                                return none;
+  }
+}
+//---------------------------------------------------------------------
+inline blob_hash hash_of(const ipc_message::byte_buffer& body)
+{
+  const auto hash = murmur3_128(body.data(), body.size());
+  blob_hash  out;
+  std::memcpy(out.data(),     &hash.first,  sizeof(hash.first));
+  std::memcpy(out.data() + 8, &hash.second, sizeof(hash.second));
+  return out;
+}
+//---------------------------------------------------------------------
+inline bool is_manifest(const ipc_message::byte_buffer& frame)
+{
+  return frame.size() >= sizeof(MANIFEST_MAGIC) &&
+         std::memcmp(frame.data(), MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) == 0;
+}
+//---------------------------------------------------------------------
+struct hasher
+{
+  size_t operator()(const blob_hash& hash) const
+  {
+    size_t value;
+    std::memcpy(&value, hash.data(), sizeof(value));
+    return value;
+  }
+};
+} // ns blob
+//---------------------------------------------------------------------
+// Bounded LRU of bodies keyed by content hash
+class blob_store
+{
+public:
+  using evict_fn = std::function<void(const blob_hash&)>;
+//--------------------
+  explicit blob_store(size_t max_bytes = blob::MAX_BYTES, evict_fn on_evict = nullptr)
+  : m_max_bytes(max_bytes),
+    m_on_evict(on_evict)
+  {}
+//--------------------
+  // Returns a copy, as the entry may be evicted once the lock is released
+  bool find(const blob_hash& hash, ipc_message::byte_buffer& body)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(hash);
+    if (it == m_index.end())
+      return false;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    body = it->second->second;
+    return true;
+  }
+//--------------------
+  bool touch(const blob_hash& hash)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(hash);
+    if (it == m_index.end())
+      return false;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return true;
+  }
+//--------------------
+  void insert(const blob_hash& hash, const ipc_message::byte_buffer& body)
+  {
+    if (body.size() > m_max_bytes)
+      return;
+
+    std::vector<blob_hash> evicted;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (auto it = m_index.find(hash); it != m_index.end())
+      {
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+      }
+
+      m_entries.emplace_front(hash, body);
+      m_index.emplace(hash, m_entries.begin());
+      m_bytes += body.size();
+      while (m_bytes > m_max_bytes)
+      {
+        auto& last = m_entries.back();
+        m_bytes   -= last.second.size();
+        evicted.push_back(last.first);
+        m_index.erase(last.first);
+        m_entries.pop_back();
+      }
+    }
+    if (m_on_evict)
+      for (const auto& hash : evicted)
+        m_on_evict(hash);
+  }
+//--------------------
+  size_t bytes() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+  }
+
+private:
+  using entry_t = std::pair<blob_hash, ipc_message::byte_buffer>;
+  using list_t  = std::list<entry_t>;
+
+  size_t                                                          m_max_bytes;
+  size_t                                                          m_bytes{0};
+  evict_fn                                                        m_on_evict;
+  list_t                                                          m_entries;
+  std::unordered_map<blob_hash, list_t::iterator, blob::hasher> m_index;
+  mutable std::mutex                                              m_mutex;
+};
+//---------------------------------------------------------------------
+class blob_sender
+{
+public:
+  struct stats
+  {
+  uint64_t references;
+  uint64_t bytes_saved;
+  uint64_t requests_served;
+  uint64_t requests_missed;
+  };
+//--------------------
+  explicit blob_sender(size_t max_bytes = blob::MAX_BYTES, size_t min_size = blob::MIN_SIZE)
+  : m_store(max_bytes, [this](const blob_hash& hash) { forget(hash); }),
+    m_min_size(min_size)
+  {}
+//--------------------
+  // Replace acknowledged bodies with references; returns the bytes removed from the message
+  size_t encode(std::vector<ipc_message::byte_buffer>& frames)
+  {
+    if (frames.size() <= constants::index::TYPE || frames[constants::index::TYPE].empty())
+      return 0;
+
+    ipc_message::byte_buffer manifest{std::begin(blob::MANIFEST_MAGIC), std::end(blob::MANIFEST_MAGIC)};
+    size_t                   saved = 0;
+    for (const auto index : blob::frames_for(frames[constants::index::TYPE].front()))
+    {
+      if (index >= frames.size() || frames[index].size() < m_min_size)
+        continue;
+
+      auto&      frame = frames[index];
+      const auto hash  = blob::hash_of(frame);
+      if (is_acked(hash) && m_store.touch(hash))
+      {
+        saved += frame.size() - hash.size();
+        frame.assign(hash.begin(), hash.end());
+        manifest.push_back(index);
+      }
+      else
+        m_store.insert(hash, frame);
+    }
+
+    if (const size_t references = manifest.size() - sizeof(blob::MANIFEST_MAGIC))
+    {
+      frames.push_back(std::move(manifest));
+      m_references .fetch_add(references, std::memory_order_relaxed);
+      m_bytes_saved.fetch_add(saved,      std::memory_order_relaxed);
+    }
+    return saved;
+  }
+//--------------------
+  void on_ack(const blob_ack& ack)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& hash : ack.hashes())
+      m_acked.insert(hash);
+  }
+//--------------------
+  std::vector<ipc_message::u_ipc_msg_ptr> on_request(const blob_request& request)
+  {
+    std::vector<ipc_message::u_ipc_msg_ptr> replies;
+    for (const auto& hash : request.hashes())
+    {
+      ipc_message::byte_buffer body;
+      if (m_store.find(hash, body))
+        m_served.fetch_add(1, std::memory_order_relaxed);
+      else
+      {
+        forget(hash);
+        m_missed.fetch_add(1, std::memory_order_relaxed);
+      }
+      replies.push_back(std::make_unique<blob_data>(hash, body));
+    }
+    return replies;
+  }
+//--------------------
+  stats metrics() const
+  {
+    return {m_references.load(std::memory_order_relaxed), m_bytes_saved.load(std::memory_order_relaxed),
+            m_served.load(std::memory_order_relaxed),     m_missed.load(std::memory_order_relaxed)};
+  }
+
+private:
+  bool is_acked(const blob_hash& hash)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_acked.find(hash) != m_acked.end();
+  }
+//--------------------
+  void forget(const blob_hash& hash)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_acked.erase(hash);
+  }
+
+  using acked_t = std::unordered_set<blob_hash, blob::hasher>;
+
+  blob_store            m_store;
+  size_t                m_min_size;
+  acked_t               m_acked;
+  std::mutex            m_mutex;
+  std::atomic<uint64_t> m_references{0};
+  std::atomic<uint64_t> m_bytes_saved{0};
+  std::atomic<uint64_t> m_served{0};
+  std::atomic<uint64_t> m_missed{0};
+};
+//---------------------------------------------------------------------
+class blob_receiver
+{
+public:
+  using frames_t = std::vector<ipc_message::byte_buffer>;
+//--------------------
+  /**
+    Parked messages are kept in arrival order, and a message is held behind an
+    earlier parked one from the same platform, so each platform's messages are
+    released in the order they were sent. At most max_pending are parked (new
+    ones beyond that are dropped), and expire() drops any parked for longer
+    than pending_timeout.
+   */
+  explicit blob_receiver(size_t                    max_bytes       = blob::MAX_BYTES,
+                         size_t                    min_size        = blob::MIN_SIZE,
+                         size_t                    max_pending     = blob::MAX_PENDING,
+                         std::chrono::milliseconds pending_timeout = blob::PENDING_TIMEOUT)
+  : m_store(max_bytes),
+    m_min_size(min_size),
+    m_max_pending(max_pending),
+    m_pending_timeout(pending_timeout)
+  {}
+//--------------------
+  /**
+    Resolve references in place and cache any new large bodies. Returns false
+    when the message is parked: a referenced body is missing, and take_request()
+    yields the blob_request to send, or an earlier message from the same
+    platform is still parked. on_data() and expire() return it once released.
+   */
+  bool resolve(frames_t& frames)
+  {
+    if (frames.size() <= constants::index::TYPE || frames[constants::index::TYPE].empty())
+      return true;
+
+    pending_t                pending;
+    ipc_message::byte_buffer manifest;
+    if (blob::is_manifest(frames.back()))
+    {
+      manifest = std::move(frames.back());
+      frames.pop_back();
+      for (size_t i = sizeof(blob::MANIFEST_MAGIC); i < manifest.size(); i++)
+      {
+        const uint8_t index = manifest[i];
+        if (index >= frames.size() || frames[index].size() != sizeof(blob_hash))
+          continue;
+
+        blob_hash hash;
+        std::memcpy(hash.data(), frames[index].data(), hash.size());
+        if (!m_store.find(hash, frames[index]))
+          pending.missing.emplace_back(index, hash);
+      }
+    }
+    learn(frames, manifest); // new bodies sent in full alongside references
+    if (frames.size() > constants::index::PLATFORM)
+      pending.platform.assign(frames[constants::index::PLATFORM].begin(), frames[constants::index::PLATFORM].end());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (pending.missing.empty() && !m_parked.count(pending.platform))
+      return true;
+
+    if (m_pending.size() >= m_max_pending)
+    {
+      log_fn("Dropping message: too many messages awaiting referenced bodies");
+      return false;
+    }
+
+    for (const auto& [index, hash] : pending.missing)
+      if (m_requested.insert(hash).second)
+        m_request.push_back(hash);
+    pending.frames = std::move(frames);
+    pending.time   = std::chrono::steady_clock::now();
+    m_parked.insert(pending.platform);
+    m_pending.push_back(std::move(pending));
+    return false;
+  }
+//--------------------
+  // Store a requested body; returns every parked message released, in order
+  std::vector<frames_t> on_data(const blob_data& data)
+  {
+    const auto  hash = data.hash();
+    const auto& body = data.body();
+    if (!body.empty() && blob::hash_of(body) != hash)
+    {
+      log_fn("Ignoring blob data whose body does not match its hash");
+      return {};
+    }
+    if (!body.empty())
+      m_store.insert(hash, body);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requested.erase(hash);
+    for (auto it = m_pending.begin(); it != m_pending.end();)
+    {
+      auto& missing = it->missing;
+      bool  drop    = false;
+      for (auto m = missing.begin(); m != missing.end();)
+      {
+        if (m->second != hash)
+          m++;
+        else if (body.empty())
+        {
+          drop = true;
+          break;
+        }
+        else
+        {
+          it->frames[m->first] = body;
+          m = missing.erase(m);
+        }
+      }
+
+      if (drop)
+      {
+        log_fn("Dropping message: referenced body is no longer held by the sender");
+        it = m_pending.erase(it);
+      }
+      else
+        it++;
+    }
+    return release();
+  }
+//--------------------
+  // Drop messages parked longer than pending_timeout; returns those released behind them
+  std::vector<frames_t> expire()
+  {
+    const auto cutoff = std::chrono::steady_clock::now() - m_pending_timeout;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_pending.begin(); it != m_pending.end();)
+      if (!it->missing.empty() && it->time < cutoff)
+      {
+        log_fn("Dropping message: referenced body did not arrive in time");
+        it = m_pending.erase(it);
+      }
+      else
+        it++;
+    return release();
+  }
+//--------------------
+  ipc_message::u_ipc_msg_ptr take_ack()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_ack.empty())
+      return nullptr;
+    auto ack = std::make_unique<blob_ack>(m_ack);
+    m_ack.clear();
+    return ack;
+  }
+//--------------------
+  ipc_message::u_ipc_msg_ptr take_request()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_request.empty())
+      return nullptr;
+    auto request = std::make_unique<blob_request>(m_request);
+    m_request.clear();
+    return request;
+  }
+//--------------------
+  size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending.size();
+  }
+
+private:
+  struct pending_t
+  {
+  frames_t                                   frames;
+  std::vector<std::pair<uint8_t, blob_hash>> missing;
+  std::string                                platform;
+  std::chrono::steady_clock::time_point      time;
+  };
+//--------------------
+  // Release complete messages not held behind an incomplete one from the same platform
+  std::vector<frames_t> release()
+  {
+    std::vector<frames_t> complete;
+    m_parked.clear();
+    for (auto it = m_pending.begin(); it != m_pending.end();)
+      if (it->missing.empty() && !m_parked.count(it->platform))
+      {
+        complete.push_back(std::move(it->frames));
+        it = m_pending.erase(it);
+      }
+      else
+      {
+        m_parked.insert(it->platform);
+        it++;
+      }
+    return complete;
+  }
+//--------------------
+  // Cache and ack large bodies sent in full; frames the manifest references are already held or requested
+  void learn(const frames_t& frames, const ipc_message::byte_buffer& manifest)
+  {
+    const auto referenced = [&](uint8_t index)
+    {
+      return !manifest.empty() &&
+             std::find(manifest.begin() + sizeof(blob::MANIFEST_MAGIC), manifest.end(), index) != manifest.end();
+    };
+    for (const auto index : blob::frames_for(frames[constants::index::TYPE].front()))
+    {
+      if (index >= frames.size() || frames[index].size() < m_min_size || referenced(index))
+        continue;
+
+      const auto hash = blob::hash_of(frames[index]);
+      if (m_store.touch(hash))
+        continue;
+
+      m_store.insert(hash, frames[index]);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_ack.push_back(hash);
+    }
+  }
+
+  blob_store                                  m_store;
+  size_t                                      m_min_size;
+  size_t                                      m_max_pending;
+  std::chrono::milliseconds                   m_pending_timeout;
+  std::list<pending_t>                        m_pending;
+  std::set<std::string>                       m_parked; // platforms with a parked message
+  std::vector<blob_hash>                      m_ack;
+  std::vector<blob_hash>                      m_request;
+  std::unordered_set<blob_hash, blob::hasher> m_requested;
+  mutable std::mutex                          m_mutex;
+};
+} // ns kiq
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ipc.hpp"
+
+namespace kiq {
+/**
+            ┌───────────────────────────────────────────────┐
+            │░░░░░░░░░░░░░░░ CAPTURE FILE ░░░░░░░░░░░░░░░░░░│
+            │░░  Header: magic[8] | u64 committed bytes  ░░░│
+            │░░  Record: u64 ns   | u8 dir | u32 frames  ░░░│
+            │░░  Frame : u32 size | bytes                ░░░│
+            │░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░│
+            └───────────────────────────────────────────────┘
+  Values are written in host byte order. Bytes past the committed length
+  belong to a record that was never completed and are ignored on read.
+ */
+namespace capture {
+static const char   MAGIC[8]      {'K', 'P', 'C', 'A', 'P', '\0', '\0', '\1'};
+static const size_t HEADER_SIZE   {16};
+static const size_t COMMIT_OFFSET {8};
+static const size_t RECORD_HEADER {sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint32_t)};
+static const size_t GROW_SIZE     {64 * 1024 * 1024};
+
+enum class direction : uint8_t
+{
+  out = 0x00,
+  in  = 0x01
+};
+} // ns capture
+//---------------------------------------------------------------------
+struct capture_record
+{
+uint64_t                              timestamp;
+capture::direction                    dir;
+std::vector<std::span<const uint8_t>> frames;
+};
+//---------------------------------------------------------------------
+class capture_writer
+{
+public:
+  explicit capture_writer(const std::string& path, size_t grow_size = capture::GROW_SIZE)
+  : m_fd(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)),
+    m_grow(grow_size)
+  {
+    if (m_fd < 0)
+      throw std::runtime_error("Failed to open capture file: " + path);
+
+    reserve(capture::HEADER_SIZE);
+    std::memcpy(m_map, capture::MAGIC, sizeof(capture::MAGIC));
+    m_tail = capture::HEADER_SIZE;
+    commit();
+  }
+//--------------------
+  ~capture_writer()
+  {
+    if (m_map)
+      ::munmap(m_map, m_capacity);
+    if (m_fd >= 0)
+    {
+      if (::ftruncate(m_fd, m_tail) != 0)
+        log_fn("Failed to truncate capture file");
+      ::close(m_fd);
+    }
+  }
+//--------------------
+  capture_writer(const capture_writer&)            = delete;
+  capture_writer& operator=(const capture_writer&) = delete;
+//--------------------
+  void append(const std::vector<ipc_message::byte_buffer>& frames, capture::direction dir)
+  {
+    size_t size = capture::RECORD_HEADER;
+    for (const auto& frame : frames)
+      size += sizeof(uint32_t) + frame.size();
+
+    const uint64_t now   = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch()).count();
+    const uint32_t count = frames.size();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    reserve(m_tail + size);
+    uint8_t* ptr = m_map + m_tail;
+    std::memcpy(ptr, &now,   sizeof(now));   ptr += sizeof(now);
+    std::memcpy(ptr, &dir,   sizeof(dir));   ptr += sizeof(dir);
+    std::memcpy(ptr, &count, sizeof(count)); ptr += sizeof(count);
+    for (const auto& frame : frames)
+    {
+      const uint32_t frame_size = frame.size();
+      std::memcpy(ptr, &frame_size, sizeof(frame_size)); ptr += sizeof(frame_size);
+      if (frame_size)
+        std::memcpy(ptr, frame.data(), frame_size);
+      ptr += frame_size;
+    }
+    m_tail += size;
+    commit();
+  }
+//--------------------
+  frame_tap_fn tap(capture::direction dir)
+  {
+    return [this, dir](const std::vector<ipc_message::byte_buffer>& frames) { append(frames, dir); };
+  }
+//--------------------
+  size_t size() const
+  {
+    return m_tail;
+  }
+
+private:
+  void reserve(size_t needed)
+  {
+    if (needed <= m_capacity)
+      return;
+
+    const size_t capacity = ((needed / m_grow) + 1) * m_grow;
+    if (::ftruncate(m_fd, capacity) != 0)
+      throw std::runtime_error("Failed to grow capture file");
+
+    void* map = (m_map) ? ::mremap(m_map, m_capacity, capacity, MREMAP_MAYMOVE) :
+                          ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED)
+      throw std::runtime_error("Failed to map capture file");
+
+    m_map      = static_cast<uint8_t*>(map);
+    m_capacity = capacity;
+  }
+//--------------------
+  void commit()
+  {
+    const uint64_t committed = m_tail;
+    std::memcpy(m_map + capture::COMMIT_OFFSET, &committed, sizeof(committed));
+  }
+
+  int        m_fd;
+  size_t     m_grow;
+  uint8_t*   m_map{nullptr};
+  size_t     m_capacity{0};
+  size_t     m_tail{0};
+  std::mutex m_mutex;
+};
+//---------------------------------------------------------------------
+class capture_reader
+{
+public:
+  explicit capture_reader(const std::string& path)
+  {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("Failed to open capture file: " + path);
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < capture::HEADER_SIZE)
+    {
+      ::close(fd);
+      throw std::runtime_error("Invalid capture file: " + path);
+    }
+
+    m_size = st.st_size;
+    void* map = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+      throw std::runtime_error("Failed to map capture file: " + path);
+
+    m_map = static_cast<const uint8_t*>(map);
+    if (std::memcmp(m_map, capture::MAGIC, sizeof(capture::MAGIC)) != 0)
+    {
+      ::munmap(const_cast<uint8_t*>(m_map), m_size);
+      throw std::runtime_error("Invalid capture file: " + path);
+    }
+
+    uint64_t committed;
+    std::memcpy(&committed, m_map + capture::COMMIT_OFFSET, sizeof(committed));
+    m_end = std::min<size_t>(committed, m_size);
+    rewind();
+  }
+//--------------------
+  ~capture_reader()
+  {
+    ::munmap(const_cast<uint8_t*>(m_map), m_size);
+  }
+//--------------------
+  capture_reader(const capture_reader&)            = delete;
+  capture_reader& operator=(const capture_reader&) = delete;
+//--------------------
+  bool next(capture_record& record)
+  {
+    if (m_pos + capture::RECORD_HEADER > m_end)
+      return false;
+
+    size_t   pos = m_pos;
+    uint32_t count;
+    std::memcpy(&record.timestamp, m_map + pos, sizeof(record.timestamp)); pos += sizeof(record.timestamp);
+    std::memcpy(&record.dir,       m_map + pos, sizeof(record.dir));       pos += sizeof(record.dir);
+    std::memcpy(&count,            m_map + pos, sizeof(count));            pos += sizeof(count);
+
+    record.frames.clear();
+    for (uint32_t i = 0; i < count; i++)
+    {
+      uint32_t frame_size;
+      if (pos + sizeof(frame_size) > m_end)
+        return false;
+      std::memcpy(&frame_size, m_map + pos, sizeof(frame_size)); pos += sizeof(frame_size);
+      if (pos + frame_size > m_end)
+        return false;
+      record.frames.emplace_back(m_map + pos, frame_size);
+      pos += frame_size;
+    }
+    m_pos = pos;
+    return true;
+  }
+//--------------------
+  void rewind()
+  {
+    m_pos = capture::HEADER_SIZE;
+  }
+//--------------------
+  size_t size() const
+  {
+    return m_end;
+  }
+
+private:
+  const uint8_t* m_map{nullptr};
+  size_t         m_size{0};
+  size_t         m_end{0};
+  size_t         m_pos{0};
+};
+} // ns kiq
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.hpp"
+#include "ipc.hpp"
+
+namespace kiq {
+/**
+  Bounded, time-aware cache of recently seen platform_message keys, consulted
+  before DeserializeIPCMessage so reposts and retries of the same platform + id
+  + cmd are dropped without touching the payload.
+
+  The cache is split into shards, each guarded by its own mutex and evicting
+  with the CLOCK algorithm: a hit sets the entry's reference bit, and the hand
+  skips (and clears) referenced entries before evicting. The hand evicts the
+  first entry it reaches that is expired or unreferenced, so an expired entry
+  is not preferred over an unreferenced live one further along; scanning for
+  expired entries would cost a pass over the shard on every insert.
+
+  When handling of a message fails and the sender is expected to retry, call
+  forget() so the retry is not mistaken for a duplicate.
+ */
+struct dedupe_config
+{
+std::chrono::steady_clock::duration ttl{std::chrono::minutes(5)};
+size_t                              max_bytes{8 * 1024 * 1024};
+size_t                              shards{16};
+};
+//---------------------------------------------------------------------
+class dedupe_cache
+{
+public:
+  struct stats
+  {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  size_t   size;
+  size_t   capacity;
+  double   hit_rate;
+  };
+//--------------------
+  explicit dedupe_cache(const dedupe_config& cfg = dedupe_config{})
+  : m_ttl(cfg.ttl),
+    m_shards(std::max<size_t>(1, cfg.shards))
+  {
+    const size_t per_shard = std::max<size_t>(1, cfg.max_bytes / ENTRY_BYTES / m_shards.size());
+    for (auto& shard : m_shards)
+    {
+      shard.capacity = per_shard;
+      shard.slots.reserve(per_shard);
+      shard.index.reserve(per_shard);
+    }
+  }
+//--------------------
+  static std::optional<uint64_t> key_for(const std::vector<ipc_message::byte_buffer>& frames)
+  {
+    if (frames.size() <= constants::index::CMD ||
+        frames[constants::index::TYPE].empty() ||
+        frames[constants::index::TYPE].front() != constants::IPC_PLATFORM_TYPE)
+      return std::nullopt;
+
+    uint64_t hash = FNV_OFFSET;
+    for (const auto i : {constants::index::PLATFORM, constants::index::ID, constants::index::CMD})
+    {
+      const uint64_t size = frames[i].size();
+      hash = fnv1a(&size, sizeof(size), hash);
+      hash = fnv1a(frames[i].data(), frames[i].size(), hash);
+    }
+    return hash;
+  }
+//--------------------
+  // True when an unexpired entry for this message exists; otherwise records it
+  bool is_duplicate(const std::vector<ipc_message::byte_buffer>& frames)
+  {
+    const auto key = key_for(frames);
+    return key && is_duplicate(*key);
+  }
+//--------------------
+  bool is_duplicate(uint64_t key)
+  {
+    const auto now   = std::chrono::steady_clock::now();
+    auto&      shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (auto it = shard.index.find(key); it != shard.index.end())
+    {
+      auto& slot = shard.slots[it->second];
+      if (slot.expires > now)
+      {
+        slot.referenced = true;
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+      slot.expires    = now + m_ttl;
+      slot.referenced = false;
+      m_misses.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    if (shard.slots.size() < shard.capacity)
+    {
+      shard.index.emplace(key, shard.slots.size());
+      shard.slots.push_back({key, now + m_ttl, false});
+      return false;
+    }
+
+    const size_t victim = evict(shard, now);
+    shard.slots[victim] = {key, now + m_ttl, false};
+    shard.index.emplace(key, victim);
+    return false;
+  }
+//--------------------
+  void forget(const std::vector<ipc_message::byte_buffer>& frames)
+  {
+    if (const auto key = key_for(frames))
+    {
+      auto& shard = shard_for(*key);
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (auto it = shard.index.find(*key); it != shard.index.end())
+        shard.slots[it->second].expires = {};
+    }
+  }
+//--------------------
+  stats metrics()
+  {
+    size_t size = 0, capacity = 0;
+    for (auto& shard : m_shards)
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      size     += shard.index.size();
+      capacity += shard.capacity;
+    }
+    const uint64_t hits   = m_hits  .load(std::memory_order_relaxed);
+    const uint64_t misses = m_misses.load(std::memory_order_relaxed);
+    return {hits, misses, m_evictions.load(std::memory_order_relaxed), size, capacity,
+            (hits + misses) ? static_cast<double>(hits) / (hits + misses) : 0.0};
+  }
+
+private:
+  struct slot_t
+  {
+  uint64_t                              key;
+  std::chrono::steady_clock::time_point expires;
+  bool                                  referenced;
+  };
+//--------------------
+  struct shard_t
+  {
+  std::mutex                           mutex;
+  std::vector<slot_t>                  slots;
+  std::unordered_map<uint64_t, size_t> index;
+  size_t                               capacity{0};
+  size_t                               hand{0};
+  };
+  // Slot plus its index node and bucket, as allocated by libstdc++
+  static const size_t ENTRY_BYTES = sizeof(slot_t) + 48;
+//--------------------
+  shard_t& shard_for(uint64_t key)
+  {
+    return m_shards[(key >> 48) % m_shards.size()];
+  }
+//--------------------
+  size_t evict(shard_t& shard, std::chrono::steady_clock::time_point now)
+  {
+    for (;;)
+    {
+      const size_t i    = shard.hand;
+      auto&        slot = shard.slots[i];
+      shard.hand = (shard.hand + 1) % shard.slots.size();
+      if (slot.expires <= now || !slot.referenced)
+      {
+        shard.index.erase(slot.key);
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+        return i;
+      }
+      slot.referenced = false;
+    }
+  }
+
+  std::chrono::steady_clock::duration m_ttl;
+  std::vector<shard_t>                m_shards;
+  std::atomic<uint64_t>               m_hits{0};
+  std::atomic<uint64_t>               m_misses{0};
+  std::atomic<uint64_t>               m_evictions{0};
+};
+} // ns kiq
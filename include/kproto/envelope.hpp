@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "ipc.hpp"
+
+namespace kiq {
+/**
+  Read-only view over a received multipart message, for routing without a
+  full decode. Only the frames asked for are read, and forward() passes the
+  original zmq parts on untouched, so relaying a message costs O(header)
+  regardless of payload size.
+
+  offset is the number of routing frames ahead of the message's own (empty)
+  first frame, ie: 1 for the identity a ROUTER socket prepends.
+ */
+class envelope
+{
+public:
+  using parts_t = std::vector<zmq::message_t>;
+//--------------------
+  envelope() = default;
+//--------------------
+  explicit envelope(parts_t&& parts, size_t offset = 0)
+  : m_parts(std::move(parts)),
+    m_offset(offset)
+  {}
+//--------------------
+  // Receive the next message in full (all parts); false when none was available
+  bool recv(zmq::socket_t& socket, zmq::recv_flags flags = zmq::recv_flags::none)
+  {
+    m_parts.clear();
+    zmq::message_t part;
+    do
+    {
+      if (!socket.recv(part, (m_parts.empty()) ? flags : zmq::recv_flags::none))
+        return false;
+      m_parts.push_back(std::move(part));
+    }
+    while (m_parts.back().more());
+    return true;
+  }
+//--------------------
+  void set_offset(size_t offset)
+  {
+    m_offset = offset;
+  }
+//--------------------
+  bool valid() const
+  {
+    return m_parts.size() > m_offset + constants::index::TYPE && m_parts[m_offset + constants::index::TYPE].size();
+  }
+//--------------------
+  // Frames of the message itself, excluding routing frames
+  size_t size() const
+  {
+    return (m_parts.size() > m_offset) ? m_parts.size() - m_offset : 0;
+  }
+//--------------------
+  uint8_t type() const
+  {
+    return *static_cast<const uint8_t*>(m_parts.at(m_offset + constants::index::TYPE).data());
+  }
+//--------------------
+  std::string_view frame(size_t index) const
+  {
+    const auto& part = m_parts.at(m_offset + index);
+    return {static_cast<const char*>(part.data()), part.size()};
+  }
+//--------------------
+  std::string_view routing(size_t index = 0) const
+  {
+    const auto& part = m_parts.at(index);
+    return {static_cast<const char*>(part.data()), part.size()};
+  }
+//--------------------
+  // Empty for types without a platform frame (keepalive, status, blob messages)
+  std::string_view platform() const
+  {
+    return (has_platform(type()) && size() > constants::index::PLATFORM) ? frame(constants::index::PLATFORM) :
+                                                                            std::string_view{};
+  }
+//--------------------
+  std::string_view id() const
+  {
+    return (has_id(type()) && size() > constants::index::ID) ? frame(constants::index::ID) : std::string_view{};
+  }
+//--------------------
+  /**
+    Send the parts as received, without copying, and leave the envelope empty.
+    Routing frames are kept only when keep_routing is set.
+   */
+  bool forward(zmq::socket_t& socket, bool keep_routing = false)
+  {
+    return send_from(socket, (keep_routing) ? 0 : m_offset);
+  }
+//--------------------
+  // Forward to a specific peer of a ROUTER socket, replacing any routing frames
+  bool forward_to(zmq::socket_t& socket, std::string_view identity)
+  {
+    if (!socket.send(zmq::message_t{identity.data(), identity.size()}, zmq::send_flags::sndmore))
+      return false;
+    return send_from(socket, m_offset);
+  }
+//--------------------
+  // Full decode, for the messages that are not simply routed
+  ipc_message::u_ipc_msg_ptr decode() const
+  {
+    std::vector<ipc_message::byte_buffer> frames;
+    frames.reserve(size());
+    for (size_t i = m_offset; i < m_parts.size(); i++)
+    {
+      const auto* data = static_cast<const uint8_t*>(m_parts[i].data());
+      frames.emplace_back(data, data + m_parts[i].size());
+    }
+    return DeserializeIPCMessage(std::move(frames));
+  }
+//--------------------
+  parts_t& parts()
+  {
+    return m_parts;
+  }
+//--------------------
+  static bool has_platform(uint8_t type)
+  {
+    return has_platform_frame(type);
+  }
+//--------------------
+  static bool has_id(uint8_t type)
+  {
+    return has_platform(type) && type != constants::IPC_KIQ_MESSAGE;
+  }
+
+private:
+  bool send_from(zmq::socket_t& socket, size_t first)
+  {
+    bool sent = true;
+    for (size_t i = first; i < m_parts.size() && sent; i++)
+      sent = socket.send(m_parts[i], (i == m_parts.size() - 1) ? zmq::send_flags::none : zmq::send_flags::sndmore)
+               .has_value();
+    m_parts.clear();
+    return sent;
+  }
+
+  parts_t m_parts;
+  size_t  m_offset{0};
+};
+} // ns kiq
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace kiq {
+/**
+  Phi-accrual failure detection (Hayashibara et al.). Rather than a fixed
+  timeout, each peer keeps a window of recent heartbeat intervals and the
+  time since its last heartbeat is turned into a suspicion level:
+
+    phi = -log10(P(a heartbeat arrives later than this))
+
+  phi 1 means a 10% chance the peer is only late; phi 8 means 1 in 10^8. A
+  jittery link widens the distribution and so tolerates longer gaps, while a
+  steady one is suspected soon after its usual interval has passed.
+
+  acceptable_pause is added to the mean interval. Its default is the fixed
+  timeout the detector replaced, so a peer is never suspected sooner than it
+  would have been timed out before. Until a peer's first interval is observed
+  it is judged against first_interval; that interval then seeds the window.
+ */
+struct phi_config
+{
+double                    threshold       {8.0};
+size_t                    window          {200};
+std::chrono::milliseconds min_stddev      {100};
+std::chrono::milliseconds acceptable_pause{6000};
+std::chrono::milliseconds first_interval  {1000}; // expected interval before any are observed
+};
+//---------------------------------------------------------------------
+class phi_accrual
+{
+public:
+  explicit phi_accrual(const phi_config& config = phi_config{})
+  : m_config(config),
+    m_intervals(std::max<size_t>(2, config.window))
+  {}
+//--------------------
+  void add(std::chrono::milliseconds interval)
+  {
+    const double value = interval.count();
+    if (m_count)
+      push(value);
+    else
+    {
+      // Seed as though two heartbeats had arrived around the first real interval
+      push(value * 0.75);
+      push(value * 1.25);
+    }
+  }
+//--------------------
+  double phi(std::chrono::milliseconds elapsed) const
+  {
+    const double mean   = this->mean() + m_config.acceptable_pause.count();
+    const double stddev = std::max<double>(this->stddev(), m_config.min_stddev.count());
+    const double y      = (elapsed.count() - mean) / stddev;
+    // Logistic approximation of the normal CDF, as used by Akka and Cassandra
+    const double e      = std::exp(-y * (1.5976 + 0.070566 * y * y));
+    return (elapsed.count() > mean) ? -std::log10(e / (1.0 + e)) : -std::log10(1.0 - 1.0 / (1.0 + e));
+  }
+//--------------------
+  bool suspect(std::chrono::milliseconds elapsed) const
+  {
+    return phi(elapsed) >= m_config.threshold;
+  }
+//--------------------
+  double mean() const
+  {
+    return (m_count) ? m_sum / m_count : m_config.first_interval.count();
+  }
+//--------------------
+  double stddev() const
+  {
+    if (!m_count)
+      return m_config.first_interval.count() / 4.0;
+    const double mean = this->mean();
+    return std::sqrt(std::max(0.0, m_sum_sq / m_count - mean * mean));
+  }
+//--------------------
+  size_t samples() const
+  {
+    return m_count;
+  }
+
+private:
+  void push(double interval)
+  {
+    if (m_count == m_intervals.size())
+    {
+      const double oldest = m_intervals[m_next];
+      m_sum    -= oldest;
+      m_sum_sq -= oldest * oldest;
+    }
+    else
+      m_count++;
+
+    m_intervals[m_next] = interval;
+    m_next              = (m_next + 1) % m_intervals.size();
+    m_sum              += interval;
+    m_sum_sq           += interval * interval;
+  }
+
+  phi_config          m_config;
+  std::vector<double> m_intervals;
+  size_t              m_next{0};
+  size_t              m_count{0};
+  double              m_sum{0};
+  double              m_sum_sq{0};
+};
+} // ns kiq
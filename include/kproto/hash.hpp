@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace kiq {
+static const uint64_t FNV_OFFSET{0xcbf29ce484222325ULL};
+static const uint64_t FNV_PRIME {0x100000001b3ULL};
+//---------------------------------------------------------------------
+// FNV-1a; chain calls through `seed` to hash several frames as one key
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t seed = FNV_OFFSET)
+{
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  uint64_t    hash  = seed;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+//---------------------------------------------------------------------
+namespace detail {
+inline uint64_t rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+//--------------------
+inline uint64_t fmix64(uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+} // ns detail
+//---------------------------------------------------------------------
+// MurmurHash3 x64 128-bit, for content addressing of large bodies
+inline std::pair<uint64_t, uint64_t> murmur3_128(const void* data, size_t size, uint64_t seed = 0)
+{
+  using detail::rotl64;
+  static const uint64_t c1 = 0x87c37b91114253d5ULL;
+  static const uint64_t c2 = 0x4cf5ad432745937fULL;
+  const auto*  bytes   = static_cast<const uint8_t*>(data);
+  const size_t nblocks = size / 16;
+  uint64_t     h1      = seed;
+  uint64_t     h2      = seed;
+
+  for (size_t i = 0; i < nblocks; i++)
+  {
+    uint64_t k1, k2;
+    std::memcpy(&k1, bytes + i * 16,     sizeof(k1));
+    std::memcpy(&k2, bytes + i * 16 + 8, sizeof(k2));
+
+    k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    h1  = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+    k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    h2  = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  const uint8_t* tail = bytes + nblocks * 16;
+  uint64_t       k1   = 0;
+  uint64_t       k2   = 0;
+  switch (size & 15)
+  {
+    case 15: k2 ^= uint64_t(tail[14]) << 48; [[fallthrough]];
+    case 14: k2 ^= uint64_t(tail[13]) << 40; [[fallthrough]];
+    case 13: k2 ^= uint64_t(tail[12]) << 32; [[fallthrough]];
+    case 12: k2 ^= uint64_t(tail[11]) << 24; [[fallthrough]];
+    case 11: k2 ^= uint64_t(tail[10]) << 16; [[fallthrough]];
+    case 10: k2 ^= uint64_t(tail[ 9]) << 8;  [[fallthrough]];
+    case  9: k2 ^= uint64_t(tail[ 8]);
+             k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2; [[fallthrough]];
+    case  8: k1 ^= uint64_t(tail[ 7]) << 56; [[fallthrough]];
+    case  7: k1 ^= uint64_t(tail[ 6]) << 48; [[fallthrough]];
+    case  6: k1 ^= uint64_t(tail[ 5]) << 40; [[fallthrough]];
+    case  5: k1 ^= uint64_t(tail[ 4]) << 32; [[fallthrough]];
+    case  4: k1 ^= uint64_t(tail[ 3]) << 24; [[fallthrough]];
+    case  3: k1 ^= uint64_t(tail[ 2]) << 16; [[fallthrough]];
+    case  2: k1 ^= uint64_t(tail[ 1]) << 8;  [[fallthrough]];
+    case  1: k1 ^= uint64_t(tail[ 0]);
+             k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+  }
+
+  h1 ^= size; h2 ^= size;
+  h1 += h2;   h2 += h1;
+  h1  = detail::fmix64(h1);
+  h2  = detail::fmix64(h2);
+  h1 += h2;   h2 += h1;
+  return {h1, h2};
+}
+} // ns kiq
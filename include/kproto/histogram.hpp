@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace kiq {
+/**
+  Lock-free log2 histogram of nanosecond samples. Bucket N counts samples in
+  [2^N, 2^(N+1)), so percentiles are accurate to within a factor of two.
+ */
+class latency_histogram
+{
+public:
+  static const size_t BUCKETS = 64;
+//--------------------
+  void add(uint64_t ns)
+  {
+    const size_t bucket = (ns) ? 63 - __builtin_clzll(ns) : 0;
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_count         .fetch_add(1, std::memory_order_relaxed);
+    m_total         .fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (ns > max && !m_max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+      ;
+  }
+//--------------------
+  uint64_t count() const
+  {
+    return m_count.load(std::memory_order_relaxed);
+  }
+//--------------------
+  uint64_t max() const
+  {
+    return m_max.load(std::memory_order_relaxed);
+  }
+//--------------------
+  uint64_t mean() const
+  {
+    const uint64_t n = count();
+    return (n) ? m_total.load(std::memory_order_relaxed) / n : 0;
+  }
+//--------------------
+  // Upper bound of the bucket holding the requested percentile
+  uint64_t percentile(double p) const
+  {
+    const uint64_t n = count();
+    if (!n)
+      return 0;
+
+    const uint64_t target = static_cast<uint64_t>(p / 100.0 * n);
+    uint64_t       seen   = 0;
+    for (size_t i = 0; i < BUCKETS; i++)
+    {
+      seen += m_buckets[i].load(std::memory_order_relaxed);
+      if (seen > target)
+        return (i == BUCKETS - 1) ? max() : std::min(max(), (uint64_t{2} << i) - 1);
+    }
+    return max();
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKETS> m_buckets{};
+  std::atomic<uint64_t>                      m_count{0};
+  std::atomic<uint64_t>                      m_total{0};
+  std::atomic<uint64_t>                      m_max{0};
+};
+} // ns kiq
@@ -1,5 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -8,19 +20,35 @@
 #include <map>
 #include <thread>
 #include <future>
+#include <type_traits>
 #include <zmq.hpp>
 
+#include "failure_detector.hpp"
+#include "metrics.hpp"
+#include "simd.hpp"
+#include "threading.hpp"
+
 namespace kiq {
 using external_log_fn = std::function<void(const char*)>;
+using frame_tap_fn    = std::function<void(const std::vector<std::vector<uint8_t>>&)>;
 namespace
 {
   static void noop(const char*) { (void)"NOOP"; }
   external_log_fn log_fn = noop;
 } // ns
+// Shared by every translation unit, so a tap set in one sees messages decoded in all
+inline frame_tap_fn recv_tap;
 
 inline void set_log_fn(external_log_fn fn)
 {
   log_fn = fn;
+  threading::set_log_fn(fn);
+}
+//---------------------------------------------------------------------
+// Observe every frame set handed to DeserializeIPCMessage (ie: capture)
+inline void set_recv_tap(frame_tap_fn fn)
+{
+  recv_tap = fn;
 }
 /**
             ┌───────────────────────────────────────────────┐
@@ -43,8 +71,20 @@ static const uint8_t IPC_PLATFORM_INFO   {0x06};
 static const uint8_t IPC_FAIL_TYPE       {0x07};
 static const uint8_t IPC_STATUS          {0x08};
 static const uint8_t IPC_TASK_TYPE       {0x09};
+static const uint8_t IPC_BLOB_ACK        {0x0A};
+static const uint8_t IPC_BLOB_REQUEST    {0x0B};
+static const uint8_t IPC_BLOB_DATA       {0x0C};
+static const uint8_t IPC_STREAM_CHUNK    {0x0D};
+static const uint8_t IPC_TASK_LOG        {0x0E};
+
+struct type_name_t
+{
+uint8_t     type;
+const char* name;
+};
 
-static const std::unordered_map<uint8_t, const char*> IPC_MESSAGE_NAMES{
+// Built-in types; message_registry maps each to its class
+static const type_name_t IPC_TYPES[]{
   {IPC_OK_TYPE,          "IPC_OK_TYPE"},
   {IPC_KEEPALIVE_TYPE,   "IPC_KEEPALIVE_TYPE"},
   {IPC_KIQ_MESSAGE,      "IPC_KIQ_MESSAGE"},
@@ -54,20 +94,29 @@ static const std::unordered_map<uint8_t, const char*> IPC_MESSAGE_NAMES{
   {IPC_PLATFORM_INFO,    "IPC_PLATFORM_INFO"},
   {IPC_FAIL_TYPE,        "IPC_FAIL_TYPE"},
   {IPC_STATUS,           "IPC_STATUS"},
-  {IPC_TASK_TYPE,        "IPC_TASK_TYPE"}
+  {IPC_TASK_TYPE,        "IPC_TASK_TYPE"},
+  {IPC_BLOB_ACK,         "IPC_BLOB_ACK"},
+  {IPC_BLOB_REQUEST,     "IPC_BLOB_REQUEST"},
+  {IPC_BLOB_DATA,        "IPC_BLOB_DATA"},
+  {IPC_STREAM_CHUNK,     "IPC_STREAM_CHUNK"},
+  {IPC_TASK_LOG,         "IPC_TASK_LOG"}
 };
 
-static const std::unordered_map<std::string, uint8_t> IPC_MESSAGE_VALUES{
-  {"IPC_OK_TYPE",          IPC_OK_TYPE},
-  {"IPC_KEEPALIVE_TYPE",   IPC_KEEPALIVE_TYPE},
-  {"IPC_KIQ_MESSAGE",      IPC_KIQ_MESSAGE},
-  {"IPC_PLATFORM_TYPE",    IPC_PLATFORM_TYPE},
-  {"IPC_PLATFORM_ERROR",   IPC_PLATFORM_ERROR},
-  {"IPC_PLATFORM_REQUEST", IPC_PLATFORM_REQUEST},
-  {"IPC_PLATFORM_INFO",    IPC_PLATFORM_INFO},
-  {"IPC_FAIL_TYPE",        IPC_FAIL_TYPE},
-  {"IPC_STATUS",           IPC_STATUS}
-};
+static const std::unordered_map<uint8_t, const char*> IPC_MESSAGE_NAMES = []
+{
+  std::unordered_map<uint8_t, const char*> names;
+  for (const auto& entry : IPC_TYPES)
+    names.emplace(entry.type, entry.name);
+  return names;
+}();
+
+static const std::unordered_map<std::string, uint8_t> IPC_MESSAGE_VALUES = []
+{
+  std::unordered_map<std::string, uint8_t> values;
+  for (const auto& entry : IPC_TYPES)
+    values.emplace(entry.name, entry.type);
+  return values;
+}();
 
 namespace index {
 static const uint8_t EMPTY     = 0x00;
@@ -90,8 +139,19 @@ static const uint8_t DESCRIPT  = 0x04;
 static const uint8_t TASK_TYPE = 0x05;
 static const uint8_t TECH      = 0x06;
 static const uint8_t LOGS      = 0x07;
+static const uint8_t HASHES    = 0x02;
+static const uint8_t BLOB_HASH = 0x02;
+static const uint8_t BLOB      = 0x03;
+static const uint8_t STREAM    = 0x04;
+static const uint8_t SEQ       = 0x05;
+static const uint8_t FLAGS     = 0x06;
+static const uint8_t DELTA     = 0x07;
+static const uint8_t OFFSET    = 0x04;
+static const uint8_t CHUNK     = 0x05;
 } // namespace index
 
+static const uint8_t STREAM_EOS = 0x01;
+
 static const uint8_t TELEGRAM_COMMAND_INDEX = 0x00;
 static const uint8_t MASTODON_COMMAND_INDEX = 0x01;
 static const uint8_t DISCORD_COMMAND_INDEX  = 0x02;
@@ -111,6 +171,115 @@ static const unsigned char KIQ_NAME[] = {'K', 'I', 'Q'};
 } // namespace constants
 inline auto IsKeepAlive = [](auto type) { return type == constants::IPC_KEEPALIVE_TYPE; };
 //---------------------------------------------------------------------
+enum class lane : uint8_t
+{
+  control = 0x00,
+  bulk    = 0x01
+};
+//---------------------------------------------------------------------
+// Heartbeats and acknowledgements must never wait behind payload traffic
+inline lane lane_for(uint8_t type)
+{
+  switch (type)
+  {
+    case (constants::IPC_OK_TYPE):
+    case (constants::IPC_KEEPALIVE_TYPE):
+    case (constants::IPC_FAIL_TYPE):
+    case (constants::IPC_STATUS):         return lane::control;
+    default:                              return lane::bulk;
+  }
+}
+//---------------------------------------------------------------------
+// Types whose third frame names a platform
+inline bool has_platform_frame(uint8_t type)
+{
+  switch (type)
+  {
+    case (constants::IPC_KEEPALIVE_TYPE):
+    case (constants::IPC_STATUS):
+    case (constants::IPC_BLOB_ACK):
+    case (constants::IPC_BLOB_REQUEST):
+    case (constants::IPC_BLOB_DATA):      return false;
+    default:                              return true;
+  }
+}
+//---------------------------------------------------------------------
+inline void count_frames(metrics::direction dir, const std::vector<std::vector<uint8_t>>& frames)
+{
+  if (frames.size() <= constants::index::TYPE || frames[constants::index::TYPE].empty())
+    return;
+
+  size_t bytes = 0;
+  for (const auto& frame : frames)
+    bytes += frame.size();
+
+  const uint8_t    type     = frames[constants::index::TYPE][0];
+  std::string_view platform;
+  if (has_platform_frame(type) && frames.size() > constants::index::PLATFORM)
+    platform = {reinterpret_cast<const char*>(frames[constants::index::PLATFORM].data()),
+                frames[constants::index::PLATFORM].size()};
+  metrics::registry::instance().count(dir, type, platform, bytes);
+}
+//---------------------------------------------------------------------
+// Big-endian u32 frame field, as a single load and byte swap
+inline uint32_t read_u32_be(const uint8_t* bytes)
+{
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  if constexpr (std::endian::native == std::endian::little)
+    value = __builtin_bswap32(value);
+  return value;
+}
+//---------------------------------------------------------------------
+inline uint64_t read_u64_be(const uint8_t* bytes)
+{
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  if constexpr (std::endian::native == std::endian::little)
+    value = __builtin_bswap64(value);
+  return value;
+}
+//---------------------------------------------------------------------
+inline std::vector<uint8_t> u32_be_frame(uint32_t value)
+{
+  if constexpr (std::endian::native == std::endian::little)
+    value = __builtin_bswap32(value);
+  std::vector<uint8_t> frame(sizeof(value));
+  std::memcpy(frame.data(), &value, sizeof(value));
+  return frame;
+}
+//---------------------------------------------------------------------
+inline std::vector<uint8_t> u64_be_frame(uint64_t value)
+{
+  if constexpr (std::endian::native == std::endian::little)
+    value = __builtin_bswap64(value);
+  std::vector<uint8_t> frame(sizeof(value));
+  std::memcpy(frame.data(), &value, sizeof(value));
+  return frame;
+}
+//---------------------------------------------------------------------
+// Constructor argument that becomes a frame: strings are copied once, and
+// byte buffers passed as rvalues are moved in without copying
+class frame_arg
+{
+public:
+  frame_arg(const char* s)                 : m_buffer(s, s + std::strlen(s))    {}
+  frame_arg(std::string_view s)            : m_buffer(s.begin(), s.end())       {}
+  frame_arg(const std::string& s)          : m_buffer(s.begin(), s.end())       {}
+  frame_arg(const std::vector<uint8_t>& b) : m_buffer(b)                        {}
+  frame_arg(std::vector<uint8_t>&& b)      : m_buffer(std::move(b))             {}
+//--------------------
+  std::vector<uint8_t>&& take()
+  {
+    return std::move(m_buffer);
+  }
+
+private:
+  std::vector<uint8_t> m_buffer;
+};
+//---------------------------------------------------------------------
+inline const char* message_name(uint8_t type);
+//---------------------------------------------------------------------
 class ipc_message
 {
 public:
@@ -140,40 +309,70 @@ std::vector<byte_buffer> m_frames;
 //--------------------
 virtual std::string to_string() const
 {
-  return constants::IPC_MESSAGE_NAMES.at(type());
+  return message_name(type());
 }
 //--------------------
 static u_ipc_msg_ptr clone(const ipc_message& msg)
 {
   return std::make_unique<ipc_message>(msg);
 }
+
+protected:
+//--------------------
+template <typename... Frames>
+static std::vector<byte_buffer> make_frames(uint8_t type, Frames&&... frames)
+{
+  std::vector<byte_buffer> out;
+  out.reserve(2 + sizeof...(Frames));
+  out.emplace_back();
+  out.emplace_back(1, type);
+  (out.emplace_back(std::forward<Frames>(frames)), ...);
+  return out;
+}
+//--------------------
+// The first count frames of received data, with the leading (routing) frame emptied
+static std::vector<byte_buffer> copy_frames(const std::vector<byte_buffer>& data, size_t count)
+{
+  if (data.size() < count)
+    throw std::out_of_range("IPC message has too few frames");
+  std::vector<byte_buffer> frames(data.begin(), data.begin() + count);
+  frames.front().clear();
+  return frames;
+}
+//--------------------
+static std::vector<byte_buffer> take_frames(std::vector<byte_buffer>&& data, size_t count)
+{
+  if (data.size() < count)
+    throw std::out_of_range("IPC message has too few frames");
+  data.resize(count);
+  data.front().clear();
+  return std::move(data);
+}
+//--------------------
+// For fixed-width fields read from peer input, ie: a u32 sequence number
+void require_size(size_t index, size_t size) const
+{
+  if (m_frames.at(index).size() != size)
+    throw std::out_of_range("IPC message has a malformed frame");
+}
 };
 //---------------------------------------------------------------------
 class platform_error : public ipc_message
 {
 public:
-platform_error(const std::string& name, const std::string& id, const std::string& user, const std::string& error)
-{
-  m_frames = {
-    byte_buffer{},
-    byte_buffer{constants::IPC_PLATFORM_ERROR},
-    byte_buffer{name.data(), name.data() + name.size()},
-    byte_buffer{id.data(), id.data() + id.size()},
-    byte_buffer{user.data(), user.data() + user.size()},
-    byte_buffer{error.data(), error.data() + error.size()}
-  };
+platform_error(frame_arg name, frame_arg id, frame_arg user, frame_arg error)
+{
+  m_frames = make_frames(constants::IPC_PLATFORM_ERROR, name.take(), id.take(), user.take(), error.take());
 }
 //---------------------------------------------------------------------
 platform_error(const std::vector<byte_buffer>& data)
 {
-  m_frames = {
-    byte_buffer{},
-    byte_buffer{data.at(constants::index::TYPE)},
-    byte_buffer{data.at(constants::index::PLATFORM)},
-    byte_buffer{data.at(constants::index::ID)},
-    byte_buffer{data.at(constants::index::USER)},
-    byte_buffer{data.at(constants::index::ERROR)}
-  };
+  m_frames = copy_frames(data, constants::index::ERROR + 1);
+}
+//--------------------
+platform_error(std::vector<byte_buffer>&& data)
+{
+  m_frames = take_frames(std::move(data), constants::index::ERROR + 1);
 }
 //--------------------
 const std::string name() const
@@ -221,25 +420,30 @@ std::string to_string() const override
 class okay_message : public ipc_message
 {
 public:
-  okay_message(const std::string& platform = "", const std::string id = "")
+  okay_message(frame_arg platform = "", frame_arg id = "")
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{constants::IPC_OK_TYPE},
-      byte_buffer{platform.data(), platform.data() + platform.size()},
-      byte_buffer{id.data(), id.data() + id.size() }};
+    m_frames = make_frames(constants::IPC_OK_TYPE, platform.take(), id.take());
   }
 //--------------------
   okay_message(const std::vector<byte_buffer>& data)
   {
-    m_frames = {
-    byte_buffer{},
-    byte_buffer{data.at(constants::index::TYPE)},
-    byte_buffer{data.at(constants::index::PLATFORM)},
-    byte_buffer{data.at(constants::index::ID)}};
+    m_frames = copy_frames(data, constants::index::ID + 1);
+  }
+//--------------------
+  okay_message(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::ID + 1);
   }
 //--------------------
   virtual ~okay_message() override {}
+//--------------------
+  std::string platform() const
+  {
+    return std::string{
+      reinterpret_cast<const char*>(m_frames.at(constants::index::PLATFORM).data()),
+      m_frames.at(constants::index::PLATFORM).size()
+    };
+  }
 //--------------------
   std::string id() const
   {
@@ -253,25 +457,30 @@ public:
 class fail_message : public ipc_message
 {
 public:
-  fail_message(const std::string& platform = "", const std::string id = "")
+  fail_message(frame_arg platform = "", frame_arg id = "")
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{constants::IPC_FAIL_TYPE},
-      byte_buffer{platform.data(), platform.data() + platform.size()},
-      byte_buffer{id.data(), id.data() + id.size() }};
+    m_frames = make_frames(constants::IPC_FAIL_TYPE, platform.take(), id.take());
   }
 //--------------------
   fail_message(const std::vector<byte_buffer>& data)
   {
-    m_frames = {
-    byte_buffer{},
-    byte_buffer{data.at(constants::index::TYPE)},
-    byte_buffer{data.at(constants::index::PLATFORM)},
-    byte_buffer{data.at(constants::index::ID)}};
+    m_frames = copy_frames(data, constants::index::ID + 1);
+  }
+//--------------------
+  fail_message(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::ID + 1);
   }
 //--------------------
   virtual ~fail_message() override {}
+//--------------------
+  std::string platform() const
+  {
+    return std::string{
+      reinterpret_cast<const char*>(m_frames.at(constants::index::PLATFORM).data()),
+      m_frames.at(constants::index::PLATFORM).size()
+    };
+  }
 //--------------------
   std::string id() const
   {
@@ -299,24 +508,19 @@ public:
 class kiq_message : public ipc_message
 {
 public:
-  kiq_message(const std::string& payload, const std::string& platform = "")
+  kiq_message(frame_arg payload, frame_arg platform = "")
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{constants::IPC_KIQ_MESSAGE},
-      byte_buffer{platform.data(), platform.data() + platform.size()},
-      byte_buffer{payload.data(), payload.data() + payload.size()}
-    };
+    m_frames = make_frames(constants::IPC_KIQ_MESSAGE, platform.take(), payload.take());
   }
 //--------------------
   kiq_message(const std::vector<byte_buffer>& data)
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{data.at(constants::index::TYPE)},
-      byte_buffer{data.at(constants::index::PLATFORM)},
-      byte_buffer{data.at(constants::index::KIQ_DATA)}
-    };
+    m_frames = copy_frames(data, constants::index::KIQ_DATA + 1);
+  }
+//--------------------
+  kiq_message(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::KIQ_DATA + 1);
   }
   //--------------------
   const std::string platform() const
@@ -340,35 +544,24 @@ public:
 
 };
 //---------------------------------------------------------------------
+// logs holds the whole log; send later output as task_log chunks (task_log.hpp)
 class task : public ipc_message
 {
 public:
-  task(const std::string& id, const std::string& desc, const std::string& type, const std::string& tech, const std::string& logs)
+  task(frame_arg id, frame_arg desc, frame_arg type, frame_arg tech, frame_arg logs)
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{constants::IPC_TASK_TYPE},
-      byte_buffer{constants::KIQ_NAME, constants::KIQ_NAME + 3},
-      byte_buffer{id.data(), id.data() + id.size()},
-      byte_buffer{desc.data(), desc.data() + desc.size()},
-      byte_buffer{type.data(), type.data() + type.size()},
-      byte_buffer{tech.data(),    tech.data() + tech.size()},
-      byte_buffer{logs.data(), logs.data() + logs.size()}
-    };
+    m_frames = make_frames(constants::IPC_TASK_TYPE, byte_buffer{constants::KIQ_NAME, constants::KIQ_NAME + 3},
+                           id.take(), desc.take(), type.take(), tech.take(), logs.take());
   }
 //--------------------
   task(const std::vector<byte_buffer>& data)
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{data.at(constants::index::TYPE)},
-      byte_buffer{data.at(constants::index::PLATFORM)},
-      byte_buffer{data.at(constants::index::ID)},
-      byte_buffer{data.at(constants::index::DESCRIPT)},
-      byte_buffer{data.at(constants::index::INFO_TYPE)},
-      byte_buffer{data.at(constants::index::TECH)},
-      byte_buffer{data.at(constants::index::LOGS)}
-    };
+    m_frames = copy_frames(data, constants::index::LOGS + 1);
+  }
+//--------------------
+  task(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::LOGS + 1);
   }
 //--------------------
   virtual ~task() override {}
@@ -436,41 +629,32 @@ public:
 class platform_message : public ipc_message
 {
 public:
-  platform_message(const std::string& platform, const std::string& id, const std::string& user, const std::string& content, const std::string& urls, const bool repost = false, uint32_t cmd = 0x00, const std::string& args = "", const std::string& time = "")
+  struct decoded_t
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{constants::IPC_PLATFORM_TYPE},
-      byte_buffer{platform.data(), platform.data() + platform.size()},
-      byte_buffer{id.data(), id.data() + id.size()},
-      byte_buffer{user.data(), user.data() + user.size()},
-      byte_buffer{content.data(), content.data() + content.size()},
-      byte_buffer{urls.data(),    urls.data() + urls.size()},
+  uint32_t                                             cmd;
+  bool                                                 repost;
+  std::optional<std::chrono::system_clock::time_point> time;
+  std::vector<std::string_view>                        urls;
+  };
+//--------------------
+  platform_message(frame_arg platform, frame_arg id, frame_arg user, frame_arg content, frame_arg urls, const bool repost = false, uint32_t cmd = 0x00, frame_arg args = "", frame_arg time = "")
+  {
+    m_frames = make_frames(constants::IPC_PLATFORM_TYPE,
+      platform.take(), id.take(), user.take(), content.take(), urls.take(),
       byte_buffer{static_cast<uint8_t>(repost)},
-      byte_buffer{args.data(), args.data() + args.size()},
-      byte_buffer{static_cast<unsigned char>((cmd >> 24) & 0xFF),
-                  static_cast<unsigned char>((cmd >> 16) & 0xFF),
-                  static_cast<unsigned char>((cmd >> 8 ) & 0xFF),
-                  static_cast<unsigned char>((cmd      ) & 0xFF)},
-      byte_buffer{time.data(), time.data() + time.size()},
-    };
+      args.take(),
+      u32_be_frame(cmd),
+      time.take());
   }
 //--------------------
   platform_message(const std::vector<byte_buffer>& data)
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{data.at(constants::index::TYPE)},
-      byte_buffer{data.at(constants::index::PLATFORM)},
-      byte_buffer{data.at(constants::index::ID)},
-      byte_buffer{data.at(constants::index::USER)},
-      byte_buffer{data.at(constants::index::DATA)},
-      byte_buffer{data.at(constants::index::URLS)},
-      byte_buffer{data.at(constants::index::REPOST)},
-      byte_buffer{data.at(constants::index::ARGS)},
-      byte_buffer{data.at(constants::index::CMD)},
-      byte_buffer{data.at(constants::index::TIME)}
-    };
+    m_frames = copy_frames(data, constants::index::TIME + 1);
+  }
+//--------------------
+  platform_message(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::TIME + 1);
   }
 //--------------------
   virtual ~platform_message() override {}
@@ -530,10 +714,7 @@ public:
 //--------------------
   uint32_t cmd() const
   {
-    auto bytes = m_frames.at(constants::index::CMD).data();
-    auto cmd   = static_cast<uint32_t>(bytes[0] << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3]);
-
-    return cmd;
+    return read_u32_be(m_frames.at(constants::index::CMD).data());
   }
 //--------------------
   std::string time() const
@@ -541,6 +722,38 @@ public:
     return std::string{reinterpret_cast<const char*>(m_frames.at(constants::index::TIME).data()),
                                                      m_frames.at(constants::index::TIME).size()};
   }
+//--------------------
+  /**
+    Typed fields, decoded on first use and cached with the message. The url
+    views point into the urls frame, so they live as long as the message and
+    its frames are left unmodified. Like the rest of the message, not meant to
+    be decoded from several threads at once.
+   */
+  const decoded_t& decoded() const
+  {
+    if (!m_decoded.value)
+    {
+      const auto& urls = m_frames.at(constants::index::URLS);
+      const auto& time = m_frames.at(constants::index::TIME);
+      m_decoded.value  = decoded_t{
+        cmd(),
+        repost(),
+        parse_time({reinterpret_cast<const char*>(time.data()), time.size()}),
+        text::split_urls({reinterpret_cast<const char*>(urls.data()), urls.size()})};
+    }
+    return *m_decoded.value;
+  }
+//--------------------
+  // Time frame as a timestamp, when it holds unix seconds
+  std::optional<std::chrono::system_clock::time_point> timestamp() const
+  {
+    return decoded().time;
+  }
+//--------------------
+  const std::vector<std::string_view>& url_list() const
+  {
+    return decoded().urls;
+  }
 //--------------------
   std::string to_string() const override
   {
@@ -557,35 +770,46 @@ public:
             "(Cmd):" + std::to_string(cmd())       + ',' +
             "(Time):" + time();
   }
+
+private:
+  static std::optional<std::chrono::system_clock::time_point> parse_time(std::string_view time)
+  {
+    int64_t seconds;
+    const auto [end, error] = std::from_chars(time.data(), time.data() + time.size(), seconds);
+    if (time.empty() || error != std::errc{} || end != time.data() + time.size())
+      return std::nullopt;
+    return std::chrono::system_clock::time_point{std::chrono::seconds{seconds}};
+  }
+//--------------------
+  // Copies decode again rather than keep views into another message's frames
+  struct cache_t
+  {
+  cache_t() = default;
+  cache_t(const cache_t&) {}
+  cache_t& operator=(const cache_t&) { value.reset(); return *this; }
+
+  std::optional<decoded_t> value;
+  };
+
+  mutable cache_t m_decoded;
 };
 //---------------------------------------------------------------------
 class platform_request : public ipc_message
 {
 public:
-  platform_request(const std::string& platform, const std::string& id, const std::string& user, const std::string& data, const std::string& args)
+  platform_request(frame_arg platform, frame_arg id, frame_arg user, frame_arg data, frame_arg args)
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{constants::IPC_PLATFORM_REQUEST},
-      byte_buffer{platform.data(), platform.data() + platform.size()},
-      byte_buffer{id.data(), id.data() + id.size()},
-      byte_buffer{user.data(), user.data() + user.size()},
-      byte_buffer{data.data(), data.data() + data.size()},
-      byte_buffer{args.data(), args.data() + args.size()}
-    };
+    m_frames = make_frames(constants::IPC_PLATFORM_REQUEST, platform.take(), id.take(), user.take(), data.take(), args.take());
   }
 //--------------------
   platform_request(const std::vector<byte_buffer>& data)
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{data.at(constants::index::TYPE)},
-      byte_buffer{data.at(constants::index::PLATFORM)},
-      byte_buffer{data.at(constants::index::ID)},
-      byte_buffer{data.at(constants::index::USER)},
-      byte_buffer{data.at(constants::index::DATA)},
-      byte_buffer{data.at(constants::index::REQ_ARGS)}
-    };
+    m_frames = copy_frames(data, constants::index::REQ_ARGS + 1);
+  }
+//--------------------
+  platform_request(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::REQ_ARGS + 1);
   }
 //--------------------
   const std::string platform() const
@@ -644,28 +868,19 @@ public:
 class platform_info : public ipc_message
 {
 public:
-  platform_info(const std::string& platform, const std::string& info, const std::string& type, const std::string& id)
+  platform_info(frame_arg platform, frame_arg info, frame_arg type, frame_arg id)
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{constants::IPC_PLATFORM_INFO},
-      byte_buffer{platform.data(), platform.data() + platform.size()},
-      byte_buffer{id.data(),       id.data()       + id.size()},
-      byte_buffer{info.data(),     info.data()     + info.size()},
-      byte_buffer{type.data(),     type.data()     + type.size()}
-    };
+    m_frames = make_frames(constants::IPC_PLATFORM_INFO, platform.take(), id.take(), info.take(), type.take());
   }
 //--------------------
   platform_info(const std::vector<byte_buffer>& data)
   {
-    m_frames = {
-      byte_buffer{},
-      byte_buffer{data.at(constants::index::TYPE)},
-      byte_buffer{data.at(constants::index::PLATFORM)},
-      byte_buffer{data.at(constants::index::ID)},
-      byte_buffer{data.at(constants::index::INFO)},
-      byte_buffer{data.at(constants::index::INFO_TYPE)}
-    };
+    m_frames = copy_frames(data, constants::index::INFO_TYPE + 1);
+  }
+//--------------------
+  platform_info(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::INFO_TYPE + 1);
   }
 //--------------------
   const std::string platform() const
@@ -720,52 +935,466 @@ public:
       byte_buffer{constants::IPC_STATUS}
     };
   }
+//--------------------
+  // Reply carrying a metrics snapshot, ie: status_check{metrics::registry::instance().read()}
+  explicit status_check(const metrics::snapshot& stats)
+  {
+    m_frames = make_frames(constants::IPC_STATUS, metrics::serialize(stats));
+  }
+//--------------------
+  status_check(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), std::min<size_t>(data.size(), constants::index::TYPE + 2));
+  }
 //--------------------
   virtual ~status_check() override = default;
+//--------------------
+  // Empty for a plain status request
+  std::optional<metrics::snapshot> snapshot() const
+  {
+    if (m_frames.size() <= constants::index::TYPE + 1)
+      return std::nullopt;
+    return metrics::parse(m_frames[constants::index::TYPE + 1]);
+  }
+};
+//---------------------------------------------------------------------
+using blob_hash = std::array<uint8_t, 16>;
+//---------------------------------------------------------------------
+class blob_list_message : public ipc_message
+{
+public:
+  blob_list_message(uint8_t type, const std::vector<blob_hash>& hashes)
+  {
+    byte_buffer list;
+    list.reserve(hashes.size() * sizeof(blob_hash));
+    for (const auto& hash : hashes)
+      list.insert(list.end(), hash.begin(), hash.end());
+
+    m_frames = make_frames(type, std::move(list));
+  }
+//--------------------
+  blob_list_message(const std::vector<byte_buffer>& data)
+  {
+    m_frames = copy_frames(data, constants::index::HASHES + 1);
+  }
+//--------------------
+  blob_list_message(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::HASHES + 1);
+  }
+//--------------------
+  std::vector<blob_hash> hashes() const
+  {
+    const auto&            list = m_frames.at(constants::index::HASHES);
+    std::vector<blob_hash> hashes(list.size() / sizeof(blob_hash));
+    for (size_t i = 0; i < hashes.size(); i++)
+      std::memcpy(hashes[i].data(), list.data() + i * sizeof(blob_hash), sizeof(blob_hash));
+    return hashes;
+  }
+//--------------------
+  std::string to_string() const override
+  {
+    return "(Type):" + ipc_message::to_string() + ',' +
+           "(Hashes):" + std::to_string(m_frames.at(constants::index::HASHES).size() / sizeof(blob_hash));
+  }
+};
+//---------------------------------------------------------------------
+// Receiver has cached these bodies; the sender may now reference them by hash
+class blob_ack : public blob_list_message
+{
+public:
+  blob_ack(const std::vector<blob_hash>& hashes)
+  : blob_list_message(constants::IPC_BLOB_ACK, hashes)
+  {}
+//--------------------
+  blob_ack(const std::vector<byte_buffer>& data)
+  : blob_list_message(data)
+  {}
+//--------------------
+  blob_ack(std::vector<byte_buffer>&& data)
+  : blob_list_message(std::move(data))
+  {}
+};
+//---------------------------------------------------------------------
+// Receiver could not resolve these references and needs the bodies
+class blob_request : public blob_list_message
+{
+public:
+  blob_request(const std::vector<blob_hash>& hashes)
+  : blob_list_message(constants::IPC_BLOB_REQUEST, hashes)
+  {}
+//--------------------
+  blob_request(const std::vector<byte_buffer>& data)
+  : blob_list_message(data)
+  {}
+//--------------------
+  blob_request(std::vector<byte_buffer>&& data)
+  : blob_list_message(std::move(data))
+  {}
+};
+//---------------------------------------------------------------------
+// Body answering a blob_request. An empty body means the sender no longer holds it
+class blob_data : public ipc_message
+{
+public:
+  blob_data(const blob_hash& hash, frame_arg body)
+  {
+    m_frames = make_frames(constants::IPC_BLOB_DATA, byte_buffer{hash.begin(), hash.end()}, body.take());
+  }
+//--------------------
+  blob_data(const std::vector<byte_buffer>& data)
+  {
+    m_frames = copy_frames(data, constants::index::BLOB + 1);
+  }
+//--------------------
+  blob_data(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::BLOB + 1);
+  }
+//--------------------
+  blob_hash hash() const
+  {
+    blob_hash   hash{};
+    const auto& frame = m_frames.at(constants::index::BLOB_HASH);
+    std::memcpy(hash.data(), frame.data(), std::min(frame.size(), hash.size()));
+    return hash;
+  }
+//--------------------
+  const byte_buffer& body() const
+  {
+    return m_frames.at(constants::index::BLOB);
+  }
+//--------------------
+  std::string to_string() const override
+  {
+    return "(Type):" + ipc_message::to_string() + ',' +
+           "(Size):" + std::to_string(body().size());
+  }
+};
+//---------------------------------------------------------------------
+/**
+  One sequence-numbered piece of incrementally delivered output (ie: a
+  generate response), carrying only the text added since the previous chunk.
+  The final chunk of a stream sets STREAM_EOS and may carry a last delta.
+  Frames: platform | id | type | seq (u32) | flags (u8) | delta
+ */
+class stream_chunk : public ipc_message
+{
+public:
+  stream_chunk(frame_arg platform, frame_arg id, frame_arg type, uint32_t seq, frame_arg delta, bool eos = false)
+  {
+    m_frames = make_frames(constants::IPC_STREAM_CHUNK, platform.take(), id.take(), type.take(),
+      u32_be_frame(seq),
+      byte_buffer{(eos) ? constants::STREAM_EOS : uint8_t{0x00}},
+      delta.take());
+  }
+//--------------------
+  stream_chunk(const std::vector<byte_buffer>& data)
+  {
+    m_frames = copy_frames(data, constants::index::DELTA + 1);
+    require_size(constants::index::SEQ, sizeof(uint32_t));
+  }
+//--------------------
+  stream_chunk(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::DELTA + 1);
+    require_size(constants::index::SEQ, sizeof(uint32_t));
+  }
+//--------------------
+  std::string platform() const
+  {
+    return std::string{
+      reinterpret_cast<const char*>(m_frames.at(constants::index::PLATFORM).data()),
+      m_frames.at(constants::index::PLATFORM).size()
+    };
+  }
+//--------------------
+  std::string id() const
+  {
+    return std::string{
+      reinterpret_cast<const char*>(m_frames.at(constants::index::ID).data()),
+      m_frames.at(constants::index::ID).size()
+    };
+  }
+//--------------------
+  std::string info_type() const
+  {
+    return std::string{
+      reinterpret_cast<const char*>(m_frames.at(constants::index::STREAM).data()),
+      m_frames.at(constants::index::STREAM).size()
+    };
+  }
+//--------------------
+  uint32_t seq() const
+  {
+    return read_u32_be(m_frames.at(constants::index::SEQ).data());
+  }
+//--------------------
+  bool eos() const
+  {
+    const auto& flags = m_frames.at(constants::index::FLAGS);
+    return !flags.empty() && (flags.front() & constants::STREAM_EOS);
+  }
+//--------------------
+  const byte_buffer& delta() const
+  {
+    return m_frames.at(constants::index::DELTA);
+  }
+//--------------------
+  byte_buffer take_delta()
+  {
+    return std::move(m_frames.at(constants::index::DELTA));
+  }
+//--------------------
+  std::string to_string() const override
+  {
+    return "(Type):"     + ipc_message::to_string() + ',' +
+           "(Platform):" + platform()               + ',' +
+           "(ID):"       + id()                     + ',' +
+           "(Seq):"      + std::to_string(seq())    + ',' +
+           "(EOS):"      + std::to_string(eos())    + ',' +
+           "(Size):"     + std::to_string(delta().size());
+  }
+};
+//---------------------------------------------------------------------
+/**
+  Output appended to a task's log, starting at byte offset of the whole log.
+  Sent in place of re-sending the task with its full logs frame, so each
+  update costs only the new output. See task_log.hpp.
+  Frames: platform (KIQ) | id | offset (u64) | chunk
+ */
+class task_log : public ipc_message
+{
+public:
+  task_log(frame_arg id, uint64_t offset, frame_arg chunk)
+  {
+    m_frames = make_frames(constants::IPC_TASK_LOG, byte_buffer{constants::KIQ_NAME, constants::KIQ_NAME + 3},
+                           id.take(), u64_be_frame(offset), chunk.take());
+  }
+//--------------------
+  task_log(const std::vector<byte_buffer>& data)
+  {
+    m_frames = copy_frames(data, constants::index::CHUNK + 1);
+    require_size(constants::index::OFFSET, sizeof(uint64_t));
+  }
+//--------------------
+  task_log(std::vector<byte_buffer>&& data)
+  {
+    m_frames = take_frames(std::move(data), constants::index::CHUNK + 1);
+    require_size(constants::index::OFFSET, sizeof(uint64_t));
+  }
+//--------------------
+  std::string id() const
+  {
+    return std::string{
+      reinterpret_cast<const char*>(m_frames.at(constants::index::ID).data()),
+      m_frames.at(constants::index::ID).size()
+    };
+  }
+//--------------------
+  uint64_t offset() const
+  {
+    return read_u64_be(m_frames.at(constants::index::OFFSET).data());
+  }
+//--------------------
+  // Offset just past this chunk
+  uint64_t end() const
+  {
+    return offset() + chunk().size();
+  }
+//--------------------
+  const byte_buffer& chunk() const
+  {
+    return m_frames.at(constants::index::CHUNK);
+  }
+//--------------------
+  byte_buffer take_chunk()
+  {
+    return std::move(m_frames.at(constants::index::CHUNK));
+  }
+//--------------------
+  std::string to_string() const override
+  {
+    return "(Type):"   + ipc_message::to_string()   + ',' +
+           "(ID):"     + id()                       + ',' +
+           "(Offset):" + std::to_string(offset())   + ',' +
+           "(Size):"   + std::to_string(chunk().size());
+  }
 };
 //---------------------------------------------------------------------
+/**
+  Decoder for each of the 256 type values. Built-in types are registered up
+  front; applications add their own with add() (ie: message_registry::instance()
+  .add<my_message>(0x80, "MY_MESSAGE")), and DeserializeIPCMessage then decodes
+  them like any other. Dispatch is a single load from the table.
+
+  Register types before messages of that type can arrive. The table is read
+  without locking.
+ */
+class message_registry
+{
+public:
+  using factory_t = ipc_message::u_ipc_msg_ptr (*)(std::vector<ipc_message::byte_buffer>&&);
+//--------------------
+  static message_registry& instance()
+  {
+    static message_registry registry;
+    return registry;
+  }
+//--------------------
+  // Replaces any decoder already registered for type
+  void add(uint8_t type, std::string name, factory_t factory)
+  {
+    m_names[type] = std::move(name);
+    m_factories[type].store(factory, std::memory_order_release);
+  }
+//--------------------
+  template <typename T>
+  void add(uint8_t type, std::string name)
+  {
+    add(type, std::move(name), &make<T>);
+  }
+//--------------------
+  void remove(uint8_t type)
+  {
+    m_factories[type].store(nullptr, std::memory_order_release);
+  }
+//--------------------
+  factory_t factory(uint8_t type) const
+  {
+    return m_factories[type].load(std::memory_order_acquire);
+  }
+//--------------------
+  bool contains(uint8_t type) const
+  {
+    return factory(type) != nullptr;
+  }
+//--------------------
+  const char* name(uint8_t type) const
+  {
+    return (contains(type)) ? m_names[type].c_str() : "IPC_UNKNOWN";
+  }
+//--------------------
+  std::optional<uint8_t> value(std::string_view name) const
+  {
+    for (size_t type = 0; type < m_names.size(); type++)
+      if (contains(type) && m_names[type] == name)
+        return static_cast<uint8_t>(type);
+    return std::nullopt;
+  }
+
+private:
+  message_registry()
+  {
+    builtin<okay_message>    (constants::IPC_OK_TYPE);
+    builtin<kiq_message>     (constants::IPC_KIQ_MESSAGE);
+    builtin<platform_message>(constants::IPC_PLATFORM_TYPE);
+    builtin<platform_error>  (constants::IPC_PLATFORM_ERROR);
+    builtin<platform_request>(constants::IPC_PLATFORM_REQUEST);
+    builtin<platform_info>   (constants::IPC_PLATFORM_INFO);
+    builtin<fail_message>    (constants::IPC_FAIL_TYPE);
+    builtin<status_check>    (constants::IPC_STATUS);
+    builtin<task>            (constants::IPC_TASK_TYPE);
+    builtin<blob_ack>        (constants::IPC_BLOB_ACK);
+    builtin<blob_request>    (constants::IPC_BLOB_REQUEST);
+    builtin<blob_data>       (constants::IPC_BLOB_DATA);
+    builtin<stream_chunk>    (constants::IPC_STREAM_CHUNK);
+    builtin<task_log>        (constants::IPC_TASK_LOG);
+    builtin<keepalive>       (constants::IPC_KEEPALIVE_TYPE);
+  }
+//--------------------
+  template <typename T>
+  void builtin(uint8_t type)
+  {
+    add(type, constants::IPC_MESSAGE_NAMES.at(type), &make<T>);
+  }
+//--------------------
+  template <typename T>
+  static ipc_message::u_ipc_msg_ptr make(std::vector<ipc_message::byte_buffer>&& data)
+  {
+    if constexpr (std::is_constructible_v<T, std::vector<ipc_message::byte_buffer>&&>)
+      return std::make_unique<T>(std::move(data));
+    else
+      return std::make_unique<T>(); // no fields beyond the type (ie: keepalive)
+  }
+
+  std::array<std::atomic<factory_t>, 256> m_factories{};
+  std::array<std::string, 256>            m_names;
+};
+//---------------------------------------------------------------------
+inline const char* message_name(uint8_t type)
+{
+  return message_registry::instance().name(type);
+}
+//---------------------------------------------------------------------
 inline ipc_message::u_ipc_msg_ptr DeserializeIPCMessage(std::vector<ipc_message::byte_buffer>&& data, bool no_fail = false)
 {
-  uint8_t message_type = *(data.at(constants::index::TYPE).data());
-  switch (message_type)
-  {
-    case (constants::IPC_OK_TYPE):          return std::make_unique<okay_message>    (data);
-    case (constants::IPC_KEEPALIVE_TYPE):   return std::make_unique<keepalive>       ();
-    case (constants::IPC_KIQ_MESSAGE):      return std::make_unique<kiq_message>     (data);
-    case (constants::IPC_PLATFORM_TYPE):    return std::make_unique<platform_message>(data);
-    case (constants::IPC_PLATFORM_INFO):    return std::make_unique<platform_info>   (data);
-    case (constants::IPC_PLATFORM_ERROR):   return std::make_unique<platform_error>  (data);
-    case (constants::IPC_PLATFORM_REQUEST): return std::make_unique<platform_request>(data);
-    case (constants::IPC_FAIL_TYPE):        return std::make_unique<fail_message>    (data);
-    case (constants::IPC_STATUS):           return std::make_unique<status_check>    (    );
-    default:
-      if  (no_fail)
-      {
-        auto&& msg = std::make_unique<ipc_message>();
-        auto&  frames = msg->m_frames;
-        frames.insert(frames.end(), data.begin(), data.end());
-        return std::move(msg);
-      }
+  if (recv_tap)
+    recv_tap(data);
+  count_frames(metrics::direction::in, data);
+
+  const uint8_t message_type = *(data.at(constants::index::TYPE).data());
+  if (const auto factory = message_registry::instance().factory(message_type))
+  {
+    try
+    {
+      return factory(std::move(data));
+    }
+    catch (const std::out_of_range& e) // Missing or malformed frames; data was consumed
+    {
+      metrics::registry::instance().decode_failure();
+      log_fn((std::string{"Failed to decode "} + message_name(message_type) + ": " + e.what()).c_str());
       return nullptr;
+    }
   }
+
+  metrics::registry::instance().decode_failure();
+  if  (no_fail)
+  {
+    auto msg = std::make_unique<ipc_message>();
+    msg->m_frames = std::move(data);
+    return msg;
+  }
+  return nullptr;
 }
 //---------------------------------------------------------------------
 using timepoint = std::chrono::time_point<std::chrono::system_clock>;
 using duration  = std::chrono::milliseconds;
-static const duration time_limit = std::chrono::milliseconds(6000);
+static const duration time_limit = std::chrono::milliseconds(6000); // phi_config::acceptable_pause default
 static const duration hb_rate    = std::chrono::milliseconds(300);
+static const duration sweep_rate = std::chrono::milliseconds(600);
+/**
+  Tracks heartbeating peers. Each peer's heartbeat intervals feed a phi-accrual
+  detector, so the timeout adapts to that peer's observed rate and jitter on
+  top of phi_config::acceptable_pause. That defaults to time_limit, so a slow
+  or jittery peer gets more slack than before and none is dropped sooner. A
+  peer whose suspicion level reaches phi_config::threshold has its callback
+  run: on a late heartbeat in validate(), or by the background sweep, which
+  also removes it.
+ */
 class session_daemon {
 public:
   using hbtime_t = std::pair<timepoint, duration>;
-  session_daemon()
+  session_daemon(const phi_config& config = phi_config{})
   : m_active(false),
-    m_valid(true)
+    m_valid(true),
+    m_config(config)
   {
-    m_future = std::async(std::launch::async, [this] { while (true) loop(); });
+    m_future = std::async(std::launch::async, [this]
+    {
+      threading::enter(threading::role::session);
+      while (m_running)
+        loop();
+    });
   }
 //--------------------
   ~session_daemon()
   {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running = false;
+    }
+    m_condition.notify_all();
     if (m_future.valid())
       m_future.wait();
   }
@@ -773,13 +1402,14 @@ public:
   void add_observer(std::string_view peer, std::function<void()> callback)
   {
     log_fn("Added peer: "); log_fn(peer.data());
-    observer_t observer{hbtime_t{}, callback};
-    m_observers.try_emplace(peer, observer);
-    m_observers.at(peer).first.first = std::chrono::system_clock::now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_observers.try_emplace(std::string{peer}, observer_t{hbtime_t{std::chrono::system_clock::now(), duration{}},
+                                                          callback, phi_accrual{m_config}});
   }
 //--------------------
   void reset()
   {
+    std::lock_guard<std::mutex> lock(m_mutex);
     if (!m_active) m_active = true;
     m_tp = std::chrono::system_clock::now();
   }
@@ -793,25 +1423,34 @@ public:
                tpoint   = now;
   }
 //--------------------
+  // Record a heartbeat. Returns false (and runs the callback) when it arrived after the peer was already suspect
   bool validate(std::string_view peer)
   {
-    if (m_active)
+    std::function<void()> on_fail;
     {
-      if (auto it = m_observers.find(peer); it != m_observers.end())
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_active)
       {
-        hbtime_t& time = it->second.first;
-        update_time(time);
-        if (time.second < time_limit)
-          return true;
-        else
-          it->second.second();
+        log_fn("Session daemon not active yet");
+        return false;
+      }
+
+      auto it = m_observers.find(peer);
+      if (it == m_observers.end())
+      {
+        log_fn("Peer does not exist");
+        return false;
       }
-      else
-      log_fn("Peer does not exist");
 
+      auto&      observer = it->second;
+      const bool late     = observer.detector.suspect(elapsed(observer.time));
+      update_time(observer.time);
+      observer.detector.add(observer.time.second);
+      if (!late)
+        return true;
+      on_fail = observer.callback;
     }
-    else
-      log_fn("Session daemon not active yet");
+    on_fail();
     return false;
   }
 //--------------------
@@ -828,39 +1467,124 @@ public:
 //--------------------
   bool has_observer(std::string_view peer) const
   {
+    std::lock_guard<std::mutex> lock(m_mutex);
     return m_observers.find(peer) != m_observers.end();
   }
+//--------------------
+  // Current suspicion level of a peer; nullopt when it is not observed
+  std::optional<double> phi(std::string_view peer) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_observers.find(peer); it != m_observers.end())
+      return it->second.detector.phi(elapsed(it->second.time));
+    return std::nullopt;
+  }
+//--------------------
+  std::map<std::string, double> suspicion() const
+  {
+    std::map<std::string, double> levels;
+    std::lock_guard<std::mutex>   lock(m_mutex);
+    for (const auto& [peer, observer] : m_observers)
+      levels.emplace(peer, observer.detector.phi(elapsed(observer.time)));
+    return levels;
+  }
 //--------------------
   void loop()
   {
-    using namespace std::chrono;
-    for (auto it = m_observers.begin(); it != m_observers.end();)
+    std::vector<std::function<void()>> expired;
     {
-      auto& observer = it->second;
-      if ((system_clock::now() - observer.first.first) > time_limit)
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait_for(lock, sweep_rate, [this] { return !m_running; });
+      for (auto it = m_observers.begin(); it != m_observers.end();)
       {
-        observer.second();
-        it = m_observers.erase(it);
+        auto& observer = it->second;
+        if (observer.detector.suspect(elapsed(observer.time)))
+        {
+          expired.push_back(std::move(observer.callback));
+          it = m_observers.erase(it);
+          metrics::registry::instance().eviction();
+        }
+        else
+          it++;
       }
-      else
-        it++;
-      std::this_thread::sleep_for(std::chrono::milliseconds(600));
     }
+    for (auto& callback : expired)
+      callback();
   }
 
 private:
-  using observer_t  = std::pair<hbtime_t, std::function<void()>>;
-  using observers_t = std::map<std::string_view, observer_t>;
-
-  timepoint         m_tp;
-  duration          m_duration;
-  bool              m_active;
-  bool              m_valid;
-  observers_t       m_observers;
-  std::future<void> m_future;
+  struct observer_t
+  {
+  hbtime_t              time;
+  std::function<void()> callback;
+  phi_accrual           detector;
+  };
+  using observers_t = std::map<std::string, observer_t, std::less<>>;
+//--------------------
+  static duration elapsed(const hbtime_t& time)
+  {
+    return std::chrono::duration_cast<duration>(std::chrono::system_clock::now() - time.first);
+  }
 
+  timepoint               m_tp;
+  duration                m_duration;
+  std::atomic<bool>       m_active;
+  bool                    m_valid;
+  std::atomic<bool>       m_running{true};
+  phi_config              m_config;
+  observers_t             m_observers;
+  mutable std::mutex      m_mutex;
+  std::condition_variable m_condition;
+  std::future<void>       m_future;
 };
 
+//---------------------------------------------------------------------
+inline size_t send_ipc_frames(zmq::socket_t& socket, const std::vector<ipc_message::byte_buffer>& frames)
+{
+  const size_t frame_num = frames.size();
+  size_t       bytes     = 0;
+
+  for (size_t i = 0; i < frame_num; i++)
+  {
+    const auto     flag = i == (frame_num - 1) ? zmq::send_flags::none : zmq::send_flags::sndmore;
+    const auto&    data = frames.at(i);
+    zmq::message_t message{data.size()};
+    std::memcpy(message.data(), data.data(), data.size());
+    socket.send(message, flag);
+    bytes += data.size();
+  }
+  return bytes;
+}
+//---------------------------------------------------------------------
+// Frames of at least this size are handed to zmq without copying; smaller ones are cheaper to copy
+static const size_t ZERO_COPY_MIN{1024};
+//---------------------------------------------------------------------
+inline size_t send_ipc_frames(zmq::socket_t& socket, std::vector<ipc_message::byte_buffer>&& frames)
+{
+  using byte_buffer = ipc_message::byte_buffer;
+  const size_t frame_num = frames.size();
+  size_t       bytes     = 0;
+
+  for (size_t i = 0; i < frame_num; i++)
+  {
+    const auto flag = i == (frame_num - 1) ? zmq::send_flags::none : zmq::send_flags::sndmore;
+    auto&      data = frames[i];
+    bytes += data.size();
+    if (data.size() < ZERO_COPY_MIN)
+    {
+      zmq::message_t message{data.data(), data.size()};
+      socket.send(message, flag);
+      continue;
+    }
+
+    auto*          owned = new byte_buffer(std::move(data)); // released by zmq once sent
+    zmq::message_t message{owned->data(), owned->size(),
+                           [](void*, void* hint) { delete static_cast<byte_buffer*>(hint); }, owned};
+    socket.send(message, flag);
+  }
+  return bytes;
+}
+//---------------------------------------------------------------------
 class IPCTransmitterInterface
 {
 public:
@@ -868,23 +1592,33 @@ public:
 //--------------------
   void send_ipc_message(ipc_message::u_ipc_msg_ptr message)
   {
-    const auto     payload   = message->data();
-    const size_t   frame_num = payload.size();
+    const auto& payload = message->m_frames;
 
-    for (int i = 0; i < frame_num; i++)
-    {
-      const auto     flag = i == (frame_num - 1) ? zmq::send_flags::none : zmq::send_flags::sndmore;
-      const auto     data  = payload.at(i);
-      zmq::message_t message{data.size()};
-      std::memcpy(message.data(), data.data(), data.size());
-      socket().send(message, flag);
-    }
+    if (m_tap)
+      m_tap(payload);
+    count_frames(metrics::direction::out, payload);
+
+    send_frames(std::move(message->m_frames));
     on_done();
   }
+//--------------------
+  void set_tap(frame_tap_fn fn)
+  {
+    m_tap = fn;
+  }
 
 protected:
   virtual zmq::socket_t& socket()  = 0;
   virtual void           on_done() = 0;
+//--------------------
+  // Override to deliver through something other than socket() (ie: ipc_transport)
+  virtual size_t send_frames(std::vector<ipc_message::byte_buffer>&& frames)
+  {
+    return send_ipc_frames(socket(), std::move(frames));
+  }
+
+private:
+  frame_tap_fn m_tap;
 };
 //---------------------------------------------------------------------
 class IPCBrokerInterface
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -33,6 +35,7 @@ struct IPCSendEvent
 int32_t                  event;
 std::vector<std::string> data;
 
+// Re-sends the whole text on every call; prefer stream_writer (stream.hpp) for long outputs
 void append_msg(const std::string& s)
 {
   if (data.size() > 4)
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace kiq {
+/**
+  Process-wide traffic counters. Every thread counts into its own block, with
+  plain relaxed stores to counters no other thread writes, so counting takes no
+  lock and shares no cache line. read() sums the blocks of live threads and the
+  totals left behind by threads that have exited.
+
+  Platforms are interned into at most MAX_PLATFORMS slots; any beyond that are
+  counted under the empty name. A snapshot serializes to the frame carried by a
+  status_check reply (all values big-endian):
+
+    u8 version | u64 decode failures | u64 evictions | i64 queue depth
+    u16 types     | per type    : u8 type  | traffic
+    u16 platforms | per platform: u8 length | name | traffic
+
+    traffic: u64 messages in | u64 bytes in | u64 messages out | u64 bytes out
+ */
+namespace metrics {
+static const uint8_t VERSION      {0x01};
+static const size_t  MAX_PLATFORMS{32};
+static const size_t  TYPES        {256};
+
+enum class direction : uint8_t
+{
+  in  = 0x00,
+  out = 0x01
+};
+//---------------------------------------------------------------------
+struct traffic_t
+{
+uint64_t messages_in {0};
+uint64_t bytes_in    {0};
+uint64_t messages_out{0};
+uint64_t bytes_out   {0};
+};
+//---------------------------------------------------------------------
+struct type_stats
+{
+uint8_t   type;
+traffic_t traffic;
+};
+//---------------------------------------------------------------------
+struct platform_stats
+{
+std::string name;
+traffic_t   traffic;
+};
+//---------------------------------------------------------------------
+namespace detail {
+inline void put(std::vector<uint8_t>& out, uint64_t value, size_t size)
+{
+  for (size_t i = size; i-- > 0;)
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+//--------------------
+inline bool get(const uint8_t*& ptr, const uint8_t* end, uint64_t& value, size_t size)
+{
+  if (static_cast<size_t>(end - ptr) < size)
+    return false;
+  value = 0;
+  for (size_t i = 0; i < size; i++)
+    value = (value << 8) | *ptr++;
+  return true;
+}
+//--------------------
+inline void put_traffic(std::vector<uint8_t>& out, const traffic_t& traffic)
+{
+  put(out, traffic.messages_in,  8);
+  put(out, traffic.bytes_in,     8);
+  put(out, traffic.messages_out, 8);
+  put(out, traffic.bytes_out,    8);
+}
+//--------------------
+inline bool get_traffic(const uint8_t*& ptr, const uint8_t* end, traffic_t& traffic)
+{
+  return get(ptr, end, traffic.messages_in,  8) && get(ptr, end, traffic.bytes_in,  8) &&
+         get(ptr, end, traffic.messages_out, 8) && get(ptr, end, traffic.bytes_out, 8);
+}
+} // ns detail
+//---------------------------------------------------------------------
+struct snapshot
+{
+uint64_t                    decode_failures{0};
+uint64_t                    evictions      {0};
+int64_t                     queue_depth    {0};
+std::vector<type_stats>     types;
+std::vector<platform_stats> platforms;
+};
+//---------------------------------------------------------------------
+inline std::vector<uint8_t> serialize(const snapshot& stats)
+{
+  std::vector<uint8_t> out;
+  out.reserve(27 + stats.types.size() * 33 + stats.platforms.size() * 48);
+  out.push_back(VERSION);
+  detail::put(out, stats.decode_failures, 8);
+  detail::put(out, stats.evictions,       8);
+  detail::put(out, static_cast<uint64_t>(stats.queue_depth), 8);
+  detail::put(out, stats.types.size(), 2);
+  for (const auto& row : stats.types)
+  {
+    out.push_back(row.type);
+    detail::put_traffic(out, row.traffic);
+  }
+  detail::put(out, stats.platforms.size(), 2);
+  for (const auto& row : stats.platforms)
+  {
+    const size_t size = std::min<size_t>(row.name.size(), UINT8_MAX);
+    out.push_back(static_cast<uint8_t>(size));
+    out.insert(out.end(), row.name.begin(), row.name.begin() + size);
+    detail::put_traffic(out, row.traffic);
+  }
+  return out;
+}
+//---------------------------------------------------------------------
+inline std::optional<snapshot> parse(const std::vector<uint8_t>& data)
+{
+  snapshot       stats;
+  const uint8_t* ptr = data.data();
+  const uint8_t* end = ptr + data.size();
+  uint64_t       depth, count;
+  if (data.empty() || *ptr++ != VERSION                 ||
+      !detail::get(ptr, end, stats.decode_failures, 8)  ||
+      !detail::get(ptr, end, stats.evictions,       8)  ||
+      !detail::get(ptr, end, depth,                 8)  ||
+      !detail::get(ptr, end, count,                 2))
+    return std::nullopt;
+  stats.queue_depth = static_cast<int64_t>(depth);
+
+  for (uint64_t i = 0; i < count; i++)
+  {
+    type_stats row;
+    if (ptr == end)
+      return std::nullopt;
+    row.type = *ptr++;
+    if (!detail::get_traffic(ptr, end, row.traffic))
+      return std::nullopt;
+    stats.types.push_back(row);
+  }
+
+  if (!detail::get(ptr, end, count, 2))
+    return std::nullopt;
+  for (uint64_t i = 0; i < count; i++)
+  {
+    platform_stats row;
+    if (ptr == end || static_cast<size_t>(end - ptr) < size_t{1} + *ptr)
+      return std::nullopt;
+    const size_t size = *ptr++;
+    row.name.assign(reinterpret_cast<const char*>(ptr), size);
+    ptr += size;
+    if (!detail::get_traffic(ptr, end, row.traffic))
+      return std::nullopt;
+    stats.platforms.push_back(std::move(row));
+  }
+  return stats;
+}
+//---------------------------------------------------------------------
+// Written by one thread only, so an increment needs no read-modify-write
+class counter
+{
+public:
+  void add(int64_t n)
+  {
+    m_value.store(m_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+//--------------------
+  int64_t get() const
+  {
+    return m_value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t> m_value{0};
+};
+//---------------------------------------------------------------------
+struct block_t
+{
+counter types    [TYPES][4];          // traffic_t order: messages in, bytes in, messages out, bytes out
+counter platforms[MAX_PLATFORMS][4];
+counter decode_failures;
+counter evictions;
+counter queue_depth;
+};
+//---------------------------------------------------------------------
+class registry
+{
+public:
+  // Never destroyed, so threads outliving main() may still count
+  static registry& instance()
+  {
+    static registry* shared = new registry;
+    return *shared;
+  }
+//--------------------
+  void count(direction dir, uint8_t type, std::string_view platform, size_t bytes)
+  {
+    const size_t column = (dir == direction::in) ? 0 : 2;
+    auto&        block  = local();
+    block.types[type][column    ].add(1);
+    block.types[type][column + 1].add(bytes);
+    if (!platform.empty())
+    {
+      auto& slot = block.platforms[platform_slot(platform)];
+      slot[column    ].add(1);
+      slot[column + 1].add(bytes);
+    }
+  }
+//--------------------
+  void decode_failure()
+  {
+    local().decode_failures.add(1);
+  }
+//--------------------
+  void eviction()
+  {
+    local().evictions.add(1);
+  }
+//--------------------
+  // Enqueue and dequeue may happen on different threads; only the sum is meaningful
+  void queued(int64_t delta)
+  {
+    local().queue_depth.add(delta);
+  }
+//--------------------
+  snapshot read() const
+  {
+    int64_t types[TYPES][4]{};
+    int64_t platforms[MAX_PLATFORMS][4]{};
+    int64_t failures = 0, evictions = 0, depth = 0;
+    std::vector<std::string> names;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      names = m_platforms;
+      const auto sum = [&](const block_t& block)
+      {
+        for (size_t i = 0; i < TYPES; i++)
+          for (size_t j = 0; j < 4; j++)
+            types[i][j] += block.types[i][j].get();
+        for (size_t i = 0; i < names.size(); i++)
+          for (size_t j = 0; j < 4; j++)
+            platforms[i][j] += block.platforms[i][j].get();
+        failures  += block.decode_failures.get();
+        evictions += block.evictions.get();
+        depth     += block.queue_depth.get();
+      };
+      sum(m_retired);
+      for (const auto* block : m_blocks)
+        sum(*block);
+    }
+
+    const auto traffic = [](const int64_t (&row)[4])
+    {
+      return traffic_t{static_cast<uint64_t>(row[0]), static_cast<uint64_t>(row[1]),
+                       static_cast<uint64_t>(row[2]), static_cast<uint64_t>(row[3])};
+    };
+    snapshot result;
+    result.decode_failures = failures;
+    result.evictions       = evictions;
+    result.queue_depth     = depth;
+    for (size_t i = 0; i < TYPES; i++)
+      if (types[i][0] || types[i][2])
+        result.types.push_back({static_cast<uint8_t>(i), traffic(types[i])});
+    for (size_t i = 0; i < names.size(); i++)
+      if (platforms[i][0] || platforms[i][2])
+        result.platforms.push_back({names[i], traffic(platforms[i])});
+    return result;
+  }
+
+private:
+  registry() = default;
+//--------------------
+  struct string_hash
+  {
+  using is_transparent = void;
+  size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+  };
+//--------------------
+  // Registers the calling thread's block on first use and retires it at thread exit
+  class holder_t
+  {
+  public:
+    using slots_t = std::unordered_map<std::string, size_t, string_hash, std::equal_to<>>;
+
+    explicit holder_t(registry& owner)
+    : m_owner(owner)
+    {
+      std::lock_guard<std::mutex> lock(m_owner.m_mutex);
+      m_owner.m_blocks.push_back(&block);
+    }
+
+    ~holder_t()
+    {
+      std::lock_guard<std::mutex> lock(m_owner.m_mutex);
+      auto& retired = m_owner.m_retired;
+      for (size_t i = 0; i < TYPES; i++)
+        for (size_t j = 0; j < 4; j++)
+          retired.types[i][j].add(block.types[i][j].get());
+      for (size_t i = 0; i < MAX_PLATFORMS; i++)
+        for (size_t j = 0; j < 4; j++)
+          retired.platforms[i][j].add(block.platforms[i][j].get());
+      retired.decode_failures.add(block.decode_failures.get());
+      retired.evictions      .add(block.evictions.get());
+      retired.queue_depth    .add(block.queue_depth.get());
+      std::erase(m_owner.m_blocks, &block);
+    }
+
+    block_t block;
+    slots_t slots;
+
+  private:
+    registry& m_owner;
+  };
+//--------------------
+  holder_t& holder()
+  {
+    thread_local holder_t local_holder{*this};
+    return local_holder;
+  }
+//--------------------
+  block_t& local()
+  {
+    return holder().block;
+  }
+//--------------------
+  size_t platform_slot(std::string_view platform)
+  {
+    auto& slots = holder().slots;
+    if (auto it = slots.find(platform); it != slots.end())
+      return it->second;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t slot = std::find(m_platforms.begin(), m_platforms.end(), platform) - m_platforms.begin();
+    if (slot == m_platforms.size())
+    {
+      if (slot == MAX_PLATFORMS)
+        return 0; // overflow names are not cached, so a thread's map stays bounded
+      m_platforms.emplace_back(platform);
+    }
+    slots.emplace(platform, slot);
+    return slot;
+  }
+
+  mutable std::mutex       m_mutex;
+  std::vector<block_t*>    m_blocks;
+  block_t                  m_retired;
+  std::vector<std::string> m_platforms{""};
+};
+} // ns metrics
+} // ns kiq
@@ -0,0 +1,747 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.hpp"
+#include "ipc.hpp"
+
+namespace kiq {
+/**
+            ┌───────────────────────────────────────────────┐
+            │░░░░░░░░░░░░░░░ OUTBOX SEGMENT ░░░░░░░░░░░░░░░░│
+            │░░  Header: magic[8] | u64 segment number   ░░░│
+            │░░  Record: u32 size | u32 check | u64 seq  ░░░│
+            │░░          u32 kind | u32 frames           ░░░│
+            │░░          u64 time (unix ms)              ░░░│
+            │░░  Frame : u32 size | bytes                ░░░│
+            │░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░│
+            └───────────────────────────────────────────────┘
+  Write-ahead log of outbound messages awaiting an okay_message. Entries are
+  copied into a memory-mapped segment as they are sent, so they survive the
+  process dying at any point after append() returns. A flusher thread msyncs
+  everything written since its last pass in one go (group commit), which is
+  what protects against losing the host; wait_durable() blocks until that has
+  covered a given entry.
+
+  An okay_message appends an ack record naming the entry by platform and id.
+  Segments are deleted from the front of the log once every entry in them is
+  settled, so an ack only ever disappears together with the entry it refers to.
+  On open, the segments are scanned and unsettled entries are indexed again;
+  replay() hands them back, oldest first, to be resent after a reconnect (ie: on
+  RECONNECT_IPC).
+
+  Entries that will not be acked are dead-lettered: a DEAD record settles them
+  like an ack and their frames go to config.dead_letter. That happens on a
+  fail_message, to entries older than max_age, and to the oldest entries while
+  the log exceeds max_bytes. When a new segment is started and the oldest one
+  is mostly settled, its remaining entries are copied forward so that it can be
+  deleted (compaction); a lone unacked entry does not pin the log behind it.
+
+  Segment files are named by segment number, which only ever increases, so a
+  new segment never reuses the name of one still in the log.
+
+  Records are checksummed and the scan stops at the first that does not match,
+  which discards a record torn by a crash mid-write. Values are in host order.
+ */
+namespace outbox {
+static const char     MAGIC[8]      {'K', 'P', 'O', 'B', 'O', 'X', '\0', '\2'};
+static const size_t   HEADER_SIZE   {16};
+static const size_t   RECORD_HEADER {2 * sizeof(uint32_t) + sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t)};
+static const size_t   ALIGNMENT     {8};
+static const size_t   COMPACT_RATIO {4};    // a segment at most 1/COMPACT_RATIO live is compacted
+static const uint32_t ENTRY         {0x01};
+static const uint32_t ACK           {0x02};
+static const uint32_t DEAD          {0x03};
+
+using frames_t       = std::vector<ipc_message::byte_buffer>;
+using dead_letter_fn = std::function<void(frames_t&&)>;
+//---------------------------------------------------------------------
+inline size_t aligned(size_t size)
+{
+  return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+//---------------------------------------------------------------------
+inline uint32_t checksum(const uint8_t* record, uint32_t size)
+{
+  const size_t skip = 2 * sizeof(uint32_t);
+  return static_cast<uint32_t>(murmur3_128(record + skip, size - skip, size).first);
+}
+//---------------------------------------------------------------------
+inline std::string key(std::string_view platform, std::string_view id)
+{
+  std::string key;
+  key.reserve(platform.size() + 1 + id.size());
+  key.append(platform).append(1, '\0').append(id);
+  return key;
+}
+//---------------------------------------------------------------------
+inline std::string key_of(const frames_t& frames)
+{
+  const auto view = [&frames](size_t index)
+  {
+    return (frames.size() > index) ?
+      std::string_view{reinterpret_cast<const char*>(frames[index].data()), frames[index].size()} : std::string_view{};
+  };
+  return key(view(constants::index::PLATFORM), view(constants::index::ID));
+}
+//---------------------------------------------------------------------
+inline uint64_t now_ms()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+} // ns outbox
+//---------------------------------------------------------------------
+struct outbox_config
+{
+std::string               path;                                          // directory holding the segments
+size_t                    segment_size {8 * 1024 * 1024};
+std::chrono::milliseconds flush_interval{5};
+size_t                    flush_bytes  {1024 * 1024};                    // flush early once this much is pending
+std::vector<uint8_t>      types        {constants::IPC_PLATFORM_TYPE};   // logged by tap()
+std::chrono::seconds      max_age      {std::chrono::hours(24)};         // older entries are dead-lettered; 0 keeps them
+size_t                    max_bytes    {256 * 1024 * 1024};              // oldest are dead-lettered beyond this (min 2 segments); 0 is unbounded
+outbox::dead_letter_fn    dead_letter;                                   // entries given up on; only logged when unset
+};
+//---------------------------------------------------------------------
+class outbox_log
+{
+public:
+  explicit outbox_log(const outbox_config& config)
+  : m_config(config)
+  {
+    std::filesystem::create_directories(m_config.path);
+    m_dir_fd = ::open(m_config.path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (m_dir_fd < 0)
+      throw std::runtime_error("Failed to open outbox directory: " + m_config.path);
+
+    recover();
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      expire();
+      deliver(lock);
+    }
+    m_flusher = threading::spawn(threading::role::flush, [this] { flush_loop(); });
+  }
+//--------------------
+  ~outbox_log()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running = false;
+    }
+    m_flush_cv.notify_one();
+    m_flusher.join();
+    for (auto& segment : m_segments)
+      close_segment(*segment, false);
+    for (auto& segment : m_retired)
+      close_segment(*segment, true);
+    ::close(m_dir_fd);
+  }
+//--------------------
+  outbox_log(const outbox_log&)            = delete;
+  outbox_log& operator=(const outbox_log&) = delete;
+//--------------------
+  // Log frames regardless of type; returns the entry's sequence number
+  uint64_t append(const std::vector<ipc_message::byte_buffer>& frames)
+  {
+    size_t used = outbox::RECORD_HEADER;
+    for (const auto& frame : frames)
+      used += sizeof(uint32_t) + frame.size();
+    const uint32_t size = outbox::aligned(used);
+    const uint64_t time = outbox::now_ms();
+    std::string    key  = outbox::key_of(frames);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const uint64_t seq     = m_next_seq++;
+    auto&          segment = writable(size);
+    uint8_t*       ptr     = segment.map + segment.tail + outbox::RECORD_HEADER;
+    for (const auto& frame : frames)
+    {
+      const uint32_t frame_size = frame.size();
+      std::memcpy(ptr, &frame_size, sizeof(frame_size)); ptr += sizeof(frame_size);
+      if (frame_size)
+        std::memcpy(ptr, frame.data(), frame_size);
+      ptr += frame_size;
+    }
+    std::memset(ptr, 0, size - used);
+    write_record(segment, size, seq, outbox::ENTRY, frames.size(), time);
+
+    m_entries.emplace(seq, entry_t{&segment, segment.tail, size, time, key});
+    m_by_key[std::move(key)].push_back(seq);
+    segment.live++;
+    segment.live_bytes += size;
+    commit(segment, size);
+    maintain();
+    deliver(lock);
+    return seq;
+  }
+//--------------------
+  // Tap for IPCTransmitterInterface::set_tap(): logs the configured types
+  frame_tap_fn tap()
+  {
+    return [this](const std::vector<ipc_message::byte_buffer>& frames)
+    {
+      if (frames.size() > constants::index::TYPE && !frames[constants::index::TYPE].empty() &&
+          std::find(m_config.types.begin(), m_config.types.end(), frames[constants::index::TYPE][0]) != m_config.types.end() &&
+          std::this_thread::get_id() != m_replayer)
+        append(frames);
+    };
+  }
+//--------------------
+  // Ack the oldest unsettled entry sent to platform with id; false when there is none
+  bool ack(std::string_view platform, std::string_view id)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_by_key.find(outbox::key(platform, id));
+    if (it == m_by_key.end())
+      return false;
+
+    const uint64_t seq = it->second.front();
+    it->second.pop_front();
+    if (it->second.empty())
+      m_by_key.erase(it);
+
+    settle(seq, outbox::ACK);
+    maintain();
+    deliver(lock);
+    return true;
+  }
+//--------------------
+  // Dead-letter the oldest unsettled entry sent to platform with id; false when there is none
+  bool fail(std::string_view platform, std::string_view id)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_by_key.find(outbox::key(platform, id));
+    if (it == m_by_key.end())
+      return false;
+
+    dead_letter(it->second.front());
+    maintain();
+    deliver(lock);
+    return true;
+  }
+//--------------------
+  // Settle from a received message when it is an okay_message or fail_message
+  bool ack(const ipc_message& message)
+  {
+    if (message.type() == constants::IPC_OK_TYPE)
+    {
+      const auto& okay = static_cast<const okay_message&>(message);
+      return ack(okay.platform(), okay.id());
+    }
+    if (message.type() == constants::IPC_FAIL_TYPE)
+    {
+      const auto& failed = static_cast<const fail_message&>(message);
+      return fail(failed.platform(), failed.id());
+    }
+    return false;
+  }
+//--------------------
+  /**
+    Pass every unacked entry, oldest first, to fn. Sends made by fn on this
+    thread are not logged again by tap(). Returns the number replayed.
+   */
+  template <typename F>
+  size_t replay(F&& fn)
+  {
+    std::vector<std::vector<ipc_message::byte_buffer>> pending;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      pending.reserve(m_entries.size());
+      for (const auto& [seq, entry] : m_entries)
+        pending.push_back(read_frames(*entry.segment, entry.offset));
+    }
+
+    m_replayer = std::this_thread::get_id();
+    for (auto& frames : pending)
+      fn(std::move(frames));
+    m_replayer = std::thread::id{};
+    return pending.size();
+  }
+//--------------------
+  size_t replay(IPCTransmitterInterface& transmitter)
+  {
+    return replay([&transmitter](std::vector<ipc_message::byte_buffer>&& frames)
+    {
+      if (auto message = DeserializeIPCMessage(std::move(frames)))
+        transmitter.send_ipc_message(std::move(message));
+    });
+  }
+//--------------------
+  // Block until entry seq (and everything before it) has been synced to disk
+  void wait_durable(uint64_t seq)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_durable >= seq)
+      return;
+    m_wanted = std::max(m_wanted, seq);
+    m_flush_cv.notify_one();
+    m_durable_cv.wait(lock, [this, seq] { return m_durable >= seq || !m_running; });
+  }
+//--------------------
+  void sync()
+  {
+    uint64_t last;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      last = m_next_seq - 1;
+    }
+    wait_durable(last);
+  }
+//--------------------
+  size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+//--------------------
+  size_t segments() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segments.size();
+  }
+
+private:
+  struct segment_t
+  {
+  uint64_t    number;
+  std::string path;
+  int         fd;
+  uint8_t*    map;
+  size_t      size;
+  size_t      tail;
+  size_t      synced;
+  size_t      live{0};
+  size_t      live_bytes{0};
+  };
+//--------------------
+  struct entry_t
+  {
+  segment_t*  segment;
+  size_t      offset;
+  uint32_t    size;
+  uint64_t    time;
+  std::string key;
+  };
+//--------------------
+  std::string segment_path(uint64_t number) const
+  {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.log", static_cast<unsigned long long>(number));
+    return (std::filesystem::path{m_config.path} / name).string();
+  }
+//--------------------
+  static void map_segment(segment_t& segment)
+  {
+    void* map = ::mmap(nullptr, segment.size, PROT_READ | PROT_WRITE, MAP_SHARED, segment.fd, 0);
+    if (map == MAP_FAILED)
+    {
+      ::close(segment.fd);
+      throw std::runtime_error("Failed to map outbox segment: " + segment.path);
+    }
+    segment.map = static_cast<uint8_t*>(map);
+  }
+//--------------------
+  segment_t& create_segment(size_t min_size)
+  {
+    auto segment    = std::make_unique<segment_t>();
+    segment->number = m_next_segment++;
+    segment->path   = segment_path(segment->number);
+    segment->size   = std::max(m_config.segment_size, outbox::HEADER_SIZE + min_size);
+    segment->fd     = ::open(segment->path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (segment->fd < 0 || ::ftruncate(segment->fd, segment->size) != 0)
+    {
+      if (segment->fd >= 0)
+        ::close(segment->fd);
+      throw std::runtime_error("Failed to create outbox segment: " + segment->path);
+    }
+    map_segment(*segment);
+    std::memcpy(segment->map,                   outbox::MAGIC,   sizeof(outbox::MAGIC));
+    std::memcpy(segment->map + sizeof(outbox::MAGIC), &segment->number, sizeof(segment->number));
+    segment->tail   = outbox::HEADER_SIZE;
+    segment->synced = 0;
+    m_unsynced     += outbox::HEADER_SIZE;
+    m_dir_dirty     = true;
+    m_rolled        = true;
+    m_segments.push_back(std::move(segment));
+    return *m_segments.back();
+  }
+//--------------------
+  void close_segment(segment_t& segment, bool remove)
+  {
+    ::munmap(segment.map, segment.size);
+    ::close(segment.fd);
+    if (remove && ::unlink(segment.path.c_str()) != 0)
+      log_fn(("Failed to remove outbox segment " + segment.path).c_str());
+  }
+//--------------------
+  segment_t& writable(size_t size)
+  {
+    if (m_segments.empty() || m_segments.back()->tail + size > m_segments.back()->size)
+      return create_segment(size);
+    return *m_segments.back();
+  }
+//--------------------
+  static void write_record(segment_t& segment, uint32_t size, uint64_t seq, uint32_t kind, uint32_t count, uint64_t time)
+  {
+    uint8_t* record = segment.map + segment.tail;
+    std::memcpy(record + 8,  &seq,   sizeof(seq));
+    std::memcpy(record + 16, &kind,  sizeof(kind));
+    std::memcpy(record + 20, &count, sizeof(count));
+    std::memcpy(record + 24, &time,  sizeof(time));
+    const uint32_t check = outbox::checksum(record, size);
+    std::memcpy(record + 4, &check, sizeof(check));
+    std::memcpy(record,     &size,  sizeof(size));
+  }
+//--------------------
+  void commit(segment_t& segment, size_t size)
+  {
+    segment.tail += size;
+    m_unsynced   += size;
+    if (m_unsynced >= m_config.flush_bytes)
+      m_flush_cv.notify_one();
+  }
+//--------------------
+  static std::vector<ipc_message::byte_buffer> read_frames(const segment_t& segment, size_t offset)
+  {
+    const uint8_t* ptr = segment.map + offset + outbox::RECORD_HEADER;
+    uint32_t       count;
+    std::memcpy(&count, segment.map + offset + 20, sizeof(count));
+
+    std::vector<ipc_message::byte_buffer> frames(count);
+    for (auto& frame : frames)
+    {
+      uint32_t frame_size;
+      std::memcpy(&frame_size, ptr, sizeof(frame_size)); ptr += sizeof(frame_size);
+      frame.assign(ptr, ptr + frame_size);
+      ptr += frame_size;
+    }
+    return frames;
+  }
+//--------------------
+  // Drop a settled entry, then any fully settled segments at the front of the log
+  void release(uint64_t seq)
+  {
+    auto it = m_entries.find(seq);
+    if (it == m_entries.end())
+      return;
+    it->second.segment->live--;
+    it->second.segment->live_bytes -= it->second.size;
+    m_entries.erase(it);
+
+    while (m_segments.size() > 1 && m_segments.front()->live == 0)
+    {
+      m_retired.push_back(std::move(m_segments.front()));
+      m_segments.pop_front();
+    }
+  }
+//--------------------
+  // Log an ACK or DEAD record for seq and drop it; its key must already be unindexed
+  void settle(uint64_t seq, uint32_t kind)
+  {
+    auto& segment = writable(outbox::RECORD_HEADER);
+    write_record(segment, outbox::RECORD_HEADER, seq, kind, 0, outbox::now_ms());
+    commit(segment, outbox::RECORD_HEADER);
+    release(seq);
+  }
+//--------------------
+  void dead_letter(uint64_t seq)
+  {
+    auto it = m_entries.find(seq);
+    if (it == m_entries.end())
+      return;
+
+    if (auto by_key = m_by_key.find(it->second.key); by_key != m_by_key.end())
+    {
+      std::erase(by_key->second, seq);
+      if (by_key->second.empty())
+        m_by_key.erase(by_key);
+    }
+    m_dead.push_back(read_frames(*it->second.segment, it->second.offset));
+    settle(seq, outbox::DEAD);
+  }
+//--------------------
+  // Copy a live entry, record and all, to the end of the log
+  void move_forward(uint64_t seq)
+  {
+    auto&      entry  = m_entries.at(seq);
+    auto&      target = writable(entry.size);
+    segment_t& source = *entry.segment;
+    std::memcpy(target.map + target.tail, source.map + entry.offset, entry.size);
+    source.live--;
+    source.live_bytes -= entry.size;
+    entry.segment      = &target;
+    entry.offset       = target.tail;
+    target.live++;
+    target.live_bytes += entry.size;
+    commit(target, entry.size);
+  }
+//--------------------
+  /**
+    After a new segment has been started: compact the oldest segment while it is
+    mostly settled, and dead-letter its entries while the log exceeds max_bytes.
+    The segment being written, and the one before it, are left alone.
+   */
+  void maintain()
+  {
+    if (!m_rolled || m_maintaining)
+      return;
+    m_maintaining = true;
+    while (m_segments.size() > 2)
+    {
+      m_rolled = false;
+      auto*      front = m_segments.front().get();
+      const bool over  = m_config.max_bytes && m_segments.size() * m_config.segment_size > m_config.max_bytes;
+      if (!over && front->live_bytes * outbox::COMPACT_RATIO > front->size)
+        break;
+
+      std::vector<uint64_t> seqs;
+      for (const auto& [seq, entry] : m_entries)
+        if (entry.segment == front)
+          seqs.push_back(seq);
+      for (const uint64_t seq : seqs)
+        if (over)
+          dead_letter(seq);
+        else
+          move_forward(seq);
+
+      if (!m_segments.empty() && m_segments.front().get() == front)
+      {
+        m_retired.push_back(std::move(m_segments.front()));
+        m_segments.pop_front();
+      }
+    }
+    m_rolled      = false;
+    m_maintaining = false;
+  }
+//--------------------
+  void expire()
+  {
+    if (m_config.max_age.count() <= 0)
+      return;
+    const uint64_t cutoff = outbox::now_ms() - std::chrono::duration_cast<std::chrono::milliseconds>(m_config.max_age).count();
+    while (!m_entries.empty() && m_entries.begin()->second.time < cutoff)
+      dead_letter(m_entries.begin()->first);
+    maintain();
+  }
+//--------------------
+  // Hand dead-lettered entries over without holding the lock
+  void deliver(std::unique_lock<std::mutex>& lock)
+  {
+    if (m_dead.empty())
+      return;
+    auto dead = std::move(m_dead);
+    m_dead.clear();
+    lock.unlock();
+    for (auto& frames : dead)
+      if (m_config.dead_letter)
+        m_config.dead_letter(std::move(frames));
+      else
+      {
+        auto key = outbox::key_of(frames);
+        std::replace(key.begin(), key.end(), '\0', ':');
+        log_fn(("Dropped outbox entry " + key).c_str());
+      }
+    lock.lock();
+  }
+//--------------------
+  void recover()
+  {
+    std::map<uint64_t, std::string> files;
+    for (const auto& file : std::filesystem::directory_iterator(m_config.path))
+    {
+      if (file.path().extension() != ".log")
+        continue;
+      const auto stem = file.path().stem().string();
+      uint64_t   number;
+      const auto [end, error] = std::from_chars(stem.data(), stem.data() + stem.size(), number, 16);
+      if (error != std::errc{} || end != stem.data() + stem.size())
+      {
+        log_fn(("Ignoring unrecognized file in outbox directory " + file.path().string()).c_str());
+        continue;
+      }
+      files.emplace(number, file.path().string());
+      m_next_segment = std::max(m_next_segment, number + 1);
+    }
+
+    for (const auto& [number, path] : files)
+    {
+      auto segment    = std::make_unique<segment_t>();
+      segment->number = number;
+      segment->path   = path;
+      segment->fd     = ::open(path.c_str(), O_RDWR);
+      struct stat st{};
+      if (segment->fd < 0 || ::fstat(segment->fd, &st) != 0 ||
+          static_cast<size_t>(st.st_size) < outbox::HEADER_SIZE)
+      {
+        if (segment->fd >= 0)
+          ::close(segment->fd);
+        log_fn(("Skipping unreadable outbox segment " + path).c_str());
+        continue;
+      }
+      segment->size = st.st_size;
+      map_segment(*segment);
+      if (std::memcmp(segment->map, outbox::MAGIC, sizeof(outbox::MAGIC)) != 0)
+      {
+        close_segment(*segment, false);
+        log_fn(("Skipping invalid outbox segment " + path).c_str());
+        continue;
+      }
+      scan(*segment);
+      m_segments.push_back(std::move(segment));
+    }
+
+    for (auto& [seq, entry] : m_entries)
+    {
+      entry.segment->live++;
+      entry.segment->live_bytes += entry.size;
+      m_by_key[entry.key].push_back(seq);
+    }
+
+    while (!m_segments.empty() && m_segments.front()->live == 0)
+    {
+      close_segment(*m_segments.front(), true);
+      m_segments.pop_front();
+    }
+  }
+//--------------------
+  void scan(segment_t& segment)
+  {
+    size_t pos = outbox::HEADER_SIZE;
+    while (pos + outbox::RECORD_HEADER <= segment.size)
+    {
+      const uint8_t* record = segment.map + pos;
+      uint32_t size, check, kind;
+      uint64_t seq;
+      std::memcpy(&size,  record,      sizeof(size));
+      std::memcpy(&check, record + 4,  sizeof(check));
+      std::memcpy(&seq,   record + 8,  sizeof(seq));
+      std::memcpy(&kind,  record + 16, sizeof(kind));
+      if (size < outbox::RECORD_HEADER || pos + size > segment.size || outbox::checksum(record, size) != check)
+        break;
+
+      if (kind == outbox::ENTRY)
+      {
+        uint64_t time;
+        std::memcpy(&time, record + 24, sizeof(time));
+        m_entries[seq] = entry_t{&segment, pos, size, time, outbox::key_of(read_frames(segment, pos))};
+        m_next_seq     = std::max(m_next_seq, seq + 1);
+      }
+      else if (kind == outbox::ACK || kind == outbox::DEAD)
+        m_entries.erase(seq);
+      pos += size;
+    }
+
+    // Clear whatever a torn write left behind so it cannot be misread later
+    if (pos + outbox::RECORD_HEADER <= segment.size)
+    {
+      uint32_t size;
+      std::memcpy(&size, segment.map + pos, sizeof(size));
+      if (size)
+        std::memset(segment.map + pos, 0, segment.size - pos);
+    }
+    segment.tail   = pos;
+    segment.synced = 0; // synced again by the first flush, in case the host went down too
+  }
+//--------------------
+  void flush_loop()
+  {
+    struct range_t
+    {
+    uint8_t* start;
+    size_t   size;
+    };
+
+    const size_t page = ::sysconf(_SC_PAGESIZE);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running)
+    {
+      m_flush_cv.wait_for(lock, m_config.flush_interval,
+        [this] { return !m_running || m_wanted > m_durable || m_unsynced >= m_config.flush_bytes; });
+      expire();
+      deliver(lock);
+
+      std::vector<range_t> ranges;
+      for (auto& segment : m_segments)
+        if (segment->synced < segment->tail)
+        {
+          const size_t start = segment->synced & ~(page - 1);
+          ranges.push_back({segment->map + start, segment->tail - start});
+          segment->synced = segment->tail;
+        }
+      const uint64_t target  = m_next_seq - 1;
+      const bool     dir     = m_dir_dirty;
+      auto           retired = std::move(m_retired);
+      m_retired.clear();
+      m_dir_dirty = false;
+      m_unsynced  = 0;
+      if (ranges.empty() && retired.empty() && !dir)
+      {
+        m_durable = target;
+        m_durable_cv.notify_all();
+        continue;
+      }
+
+      // Retired segments stay mapped until now, so the ranges above remain valid
+      lock.unlock();
+      for (const auto& range : ranges)
+        if (::msync(range.start, range.size, MS_SYNC) != 0)
+          log_fn("Failed to sync outbox segment");
+      if (dir && ::fsync(m_dir_fd) != 0)
+        log_fn("Failed to sync outbox directory");
+      for (auto& segment : retired)
+        close_segment(*segment, true);
+      lock.lock();
+
+      m_durable = std::max(m_durable, target);
+      m_durable_cv.notify_all();
+    }
+    m_durable_cv.notify_all();
+  }
+
+  outbox_config                                              m_config;
+  int                                                        m_dir_fd{-1};
+  std::deque<std::unique_ptr<segment_t>>                     m_segments;
+  std::vector<std::unique_ptr<segment_t>>                    m_retired;
+  std::map<uint64_t, entry_t>                                m_entries;
+  std::unordered_map<std::string, std::deque<uint64_t>>      m_by_key;
+  std::vector<outbox::frames_t>                              m_dead;
+  uint64_t                                                   m_next_seq{1};
+  uint64_t                                                   m_next_segment{0};
+  uint64_t                                                   m_durable{0};
+  size_t                                                     m_unsynced{0};
+  uint64_t                                                   m_wanted{0};
+  bool                                                       m_dir_dirty{false};
+  bool                                                       m_rolled{false};
+  bool                                                       m_maintaining{false};
+  bool                                                       m_running{true};
+  std::atomic<std::thread::id>                               m_replayer{};
+  mutable std::mutex                                         m_mutex;
+  std::condition_variable                                    m_flush_cv;
+  std::condition_variable                                    m_durable_cv;
+  std::thread                                                m_flusher;
+};
+} // ns kiq
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "histogram.hpp"
+#include "ipc.hpp"
+
+namespace kiq {
+/**
+  Sends control and bulk traffic over separate lanes. Each lane has its own
+  socket (its own connection to the peer, so a ROUTER fair-queues between them)
+  and its own queue. A single send thread always drains the control queue before
+  touching bulk. Both lanes hand messages to ZeroMQ without blocking, so a full
+  bulk pipe never delays a heartbeat and a full control pipe never stalls the
+  thread; a blocked lane is retried shortly after. On destruction, whatever is
+  queued is handed over, and what a full pipe will not take is dropped.
+
+  The two sockets are separate peers to a ROUTER: each has its own routing
+  identity, and replies go to whichever lane sent the request. A peer must
+  match control and bulk traffic by platform name, not by routing identity,
+  unless setup gives the lanes related identities, ie:
+
+    [&](zmq::socket_t& socket, lane selected)
+    {
+      socket.set(zmq::sockopt::routing_id, name + ((selected == lane::control) ? "/control" : "/bulk"));
+    }
+
+  setup runs on each socket before it connects.
+ */
+class priority_transmitter
+{
+public:
+  using socket_setup_fn = std::function<void(zmq::socket_t&, lane)>;
+//--------------------
+  priority_transmitter(zmq::context_t&    context,
+                       const std::string& endpoint,
+                       const std::string& control_endpoint = "",
+                       zmq::socket_type   type             = zmq::socket_type::dealer,
+                       socket_setup_fn    setup            = nullptr)
+  : m_lanes{lane_t{zmq::socket_t{context, type}}, lane_t{zmq::socket_t{context, type}}}
+  {
+    for (auto& lane : m_lanes)
+      lane.socket.set(zmq::sockopt::linger, 0);
+    if (setup)
+    {
+      setup(get(lane::control).socket, lane::control);
+      setup(get(lane::bulk)   .socket, lane::bulk);
+    }
+
+    get(lane::control).socket.connect(control_endpoint.empty() ? endpoint : control_endpoint);
+    get(lane::bulk)   .socket.connect(endpoint);
+
+    m_thread = threading::spawn(threading::role::send, [this] { run(); });
+  }
+//--------------------
+  ~priority_transmitter()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_condition.notify_one();
+    if (m_thread.joinable())
+      m_thread.join();
+    metrics::registry::instance().queued(-static_cast<int64_t>(m_lanes[0].queue.size() + m_lanes[1].queue.size()));
+  }
+//--------------------
+  void send_ipc_message(ipc_message::u_ipc_msg_ptr message)
+  {
+    if (m_tap)
+      m_tap(message->m_frames);
+    count_frames(metrics::direction::out, message->m_frames);
+
+    const auto selected = lane_for(message->type());
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      get(selected).queue.push_back({std::move(message), std::chrono::steady_clock::now()});
+    }
+    metrics::registry::instance().queued(1);
+    m_condition.notify_one();
+  }
+//--------------------
+  void set_tap(frame_tap_fn fn)
+  {
+    m_tap = fn;
+  }
+//--------------------
+  size_t queued(lane selected)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return get(selected).queue.size();
+  }
+//--------------------
+  // Time from send_ipc_message() until the message was handed to ZeroMQ
+  const latency_histogram& latency(lane selected) const
+  {
+    return m_lanes[static_cast<size_t>(selected)].latency;
+  }
+
+private:
+  struct queued_t
+  {
+  ipc_message::u_ipc_msg_ptr            message;
+  std::chrono::steady_clock::time_point enqueued;
+  };
+//--------------------
+  struct lane_t
+  {
+  zmq::socket_t        socket;
+  std::deque<queued_t> queue;
+  latency_histogram    latency;
+  };
+//--------------------
+  lane_t& get(lane selected)
+  {
+    return m_lanes[static_cast<size_t>(selected)];
+  }
+//--------------------
+  static bool try_send(zmq::socket_t& socket, const std::vector<ipc_message::byte_buffer>& frames)
+  {
+    // ZeroMQ admits multipart messages atomically on the first part
+    const auto&    first = frames.front();
+    zmq::message_t message{first.data(), first.size()};
+    const auto     flag  = (frames.size() == 1) ? zmq::send_flags::dontwait :
+                                                  zmq::send_flags::dontwait | zmq::send_flags::sndmore;
+    if (!socket.send(message, flag))
+      return false;
+
+    for (size_t i = 1; i < frames.size(); i++)
+    {
+      const auto& data = frames[i];
+      socket.send(zmq::message_t{data.data(), data.size()},
+                  (i == frames.size() - 1) ? zmq::send_flags::none : zmq::send_flags::sndmore);
+    }
+    return true;
+  }
+//--------------------
+  void record(lane_t& lane, const queued_t& item)
+  {
+    lane.latency.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - item.enqueued).count());
+  }
+//--------------------
+  void run()
+  {
+    static const auto retry = std::chrono::milliseconds(1);
+    auto&             control         = get(lane::control);
+    auto&             bulk            = get(lane::bulk);
+    bool              control_blocked = false;
+    bool              bulk_blocked    = false;
+
+    for (;;)
+    {
+      queued_t item;
+      lane_t*  from = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const auto ready = [&] { return m_stop || (!control.queue.empty() && !control_blocked) ||
+                                                  (!bulk.queue.empty()    && !bulk_blocked); };
+        if (control_blocked || bulk_blocked)
+          m_condition.wait_for(lock, retry, ready);
+        else
+          m_condition.wait(lock, ready);
+
+        // A blocked control lane yields to bulk until its retry, then goes first again
+        if (!control.queue.empty() && !control_blocked)
+          from = &control;
+        else if (!bulk.queue.empty() && !bulk_blocked)
+          from = &bulk;
+        else if (!control.queue.empty())
+          from = &control;
+        else if (!bulk.queue.empty())
+          from = &bulk;
+        else if (m_stop)
+          return;
+        else
+          continue;
+        control_blocked = bulk_blocked = false;
+
+        item = std::move(from->queue.front());
+        from->queue.pop_front();
+      }
+      metrics::registry::instance().queued(-1);
+
+      if (try_send(from->socket, item.message->m_frames))
+        record(*from, item);
+      else
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop) // Peer is not draining; drop what remains
+          return;
+        from->queue.push_front(std::move(item));
+        ((from == &control) ? control_blocked : bulk_blocked) = true;
+        metrics::registry::instance().queued(1);
+      }
+    }
+  }
+
+  std::array<lane_t, 2>   m_lanes;
+  std::mutex              m_mutex;
+  std::condition_variable m_condition;
+  std::thread             m_thread;
+  bool                    m_stop{false};
+  frame_tap_fn            m_tap;
+};
+} // ns kiq
@@ -0,0 +1,395 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ipc.hpp"
+
+namespace kiq {
+/**
+            ┌───────────────────────────────────────────────┐
+            │░░░░░░░░░░░░░ SHARED MEMORY RING ░░░░░░░░░░░░░░│
+            │░░  Header: magic | capacity | lock | cursors ░│
+            │░░  Record: u32 size | u32 frames             ░│
+            │░░  Frame : u32 size | bytes                  ░│
+            │░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░░│
+            └───────────────────────────────────────────────┘
+  A multi-producer, single-consumer ring of multipart records in a POSIX shared
+  memory object, for processes on the same host. The receiver creates the ring
+  (as a zmq socket would bind) and senders open it by name.
+
+  Producers serialize on a robust, process-shared mutex, copy the frames straight
+  into the ring and then publish the record by advancing head. A record never
+  wraps: when it does not fit before the end of the ring, a padding record fills
+  the remainder. The consumer reads frames in place and advances tail once done.
+
+  Both sides sleep on futex words inside the mapping when the ring is empty or
+  full, and are only woken when the other side has flagged that it is waiting.
+ */
+namespace shm {
+static const char     MAGIC[8]    {'K', 'P', 'S', 'H', 'M', '\0', '\0', '\1'};
+static const size_t   CAPACITY    {16 * 1024 * 1024};
+static const size_t   ALIGNMENT   {8};
+static const uint32_t PADDING     {UINT32_MAX};
+static const auto     WAIT_SLICE  {std::chrono::milliseconds(100)};
+static const auto     SEND_TIMEOUT{std::chrono::milliseconds(5000)}; // shm_transport only; shm_ring::send blocks by default
+//---------------------------------------------------------------------
+struct header_t
+{
+char                               magic[8];
+uint64_t                           capacity;
+pthread_mutex_t                    lock;
+alignas(64) std::atomic<uint64_t> head;           // published by producers
+alignas(64) std::atomic<uint64_t> tail;           // released by the consumer
+alignas(64) std::atomic<uint32_t> data_seq;       // futex: bumped on publish
+std::atomic<uint32_t>              consumer_waiting;
+alignas(64) std::atomic<uint32_t> space_seq;      // futex: bumped on release
+std::atomic<uint32_t>              producers_waiting;
+};
+static const size_t HEADER_SIZE{(sizeof(header_t) + 63) & ~size_t{63}};
+//---------------------------------------------------------------------
+inline std::string object_name(const std::string& name)
+{
+  return (name.front() == '/') ? name : "/kproto-" + name;
+}
+//---------------------------------------------------------------------
+inline size_t aligned(size_t size)
+{
+  return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+//---------------------------------------------------------------------
+inline size_t record_size(const std::vector<ipc_message::byte_buffer>& frames)
+{
+  size_t size = 2 * sizeof(uint32_t);
+  for (const auto& frame : frames)
+    size += sizeof(uint32_t) + frame.size();
+  return aligned(size);
+}
+//---------------------------------------------------------------------
+inline std::chrono::steady_clock::time_point deadline_for(std::chrono::milliseconds timeout)
+{
+  const auto now = std::chrono::steady_clock::now();
+  return (timeout >= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::time_point::max() - now)) ?
+           std::chrono::steady_clock::time_point::max() : now + timeout;
+}
+//---------------------------------------------------------------------
+inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::milliseconds timeout)
+{
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+  const auto      ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+  struct timespec ts{static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+//---------------------------------------------------------------------
+inline void futex_wake(std::atomic<uint32_t>& word, int count)
+{
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+} // ns shm
+//---------------------------------------------------------------------
+class shm_ring
+{
+public:
+  using frames_t = std::vector<std::span<const uint8_t>>;
+//--------------------
+  // Create the ring, replacing any left behind by a previous receiver
+  static std::unique_ptr<shm_ring> create(const std::string& name, size_t capacity = shm::CAPACITY)
+  {
+    const auto object = shm::object_name(name);
+    capacity          = shm::aligned(capacity);
+    ::shm_unlink(object.c_str());
+    const int fd = ::shm_open(object.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+      throw std::runtime_error("Failed to create shared memory ring: " + object);
+    if (::ftruncate(fd, shm::HEADER_SIZE + capacity) != 0)
+    {
+      ::close(fd);
+      ::shm_unlink(object.c_str());
+      throw std::runtime_error("Failed to size shared memory ring: " + object);
+    }
+
+    auto ring    = std::unique_ptr<shm_ring>(new shm_ring(fd, shm::HEADER_SIZE + capacity, object, true));
+    auto* header = new (ring->m_header) shm::header_t{};
+    header->capacity = capacity;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init      (&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust (&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init          (&header->lock, &attr);
+    pthread_mutexattr_destroy   (&attr);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, shm::MAGIC, sizeof(shm::MAGIC));
+    return ring;
+  }
+//--------------------
+  static std::unique_ptr<shm_ring> open(const std::string& name)
+  {
+    const auto  object = shm::object_name(name);
+    const int   fd     = ::shm_open(object.c_str(), O_RDWR, 0);
+    struct stat st{};
+    if (fd < 0 || ::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < shm::HEADER_SIZE)
+    {
+      if (fd >= 0)
+        ::close(fd);
+      throw std::runtime_error("Failed to open shared memory ring: " + object);
+    }
+
+    auto ring = std::unique_ptr<shm_ring>(new shm_ring(fd, st.st_size, object, false));
+    if (std::memcmp(ring->m_header->magic, shm::MAGIC, sizeof(shm::MAGIC)) != 0 ||
+        shm::HEADER_SIZE + ring->m_header->capacity != static_cast<size_t>(st.st_size))
+      throw std::runtime_error("Invalid shared memory ring: " + object);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return ring;
+  }
+//--------------------
+  ~shm_ring()
+  {
+    ::munmap(m_map, m_size);
+    if (m_owner)
+      ::shm_unlink(m_name.c_str());
+  }
+//--------------------
+  shm_ring(const shm_ring&)            = delete;
+  shm_ring& operator=(const shm_ring&) = delete;
+//--------------------
+  /**
+    Copy frames into the ring. Blocks while the ring is full, for at most timeout
+    when one is given (returning false on expiry). Throws when the record could
+    never fit.
+   */
+  bool send(const std::vector<ipc_message::byte_buffer>& frames,
+            std::chrono::milliseconds timeout = std::chrono::milliseconds::max())
+  {
+    const size_t size     = shm::record_size(frames);
+    const size_t capacity = m_header->capacity;
+    if (size > capacity)
+      throw std::runtime_error("Message exceeds shared memory ring capacity");
+
+    const auto deadline = shm::deadline_for(timeout);
+    lock();
+    uint64_t     head   = m_header->head.load(std::memory_order_relaxed);
+    const size_t offset = head % capacity;
+    if (offset + size > capacity)
+    {
+      // Published on its own: padding and record together may exceed the ring
+      const size_t padding = capacity - offset;
+      if (!wait_for_space(head + padding, deadline))
+      {
+        unlock();
+        return false;
+      }
+      write_header(offset, padding, shm::PADDING);
+      head += padding;
+      publish(head);
+    }
+
+    if (!wait_for_space(head + size, deadline))
+    {
+      unlock();
+      return false;
+    }
+
+    const size_t start = head % capacity;
+    write_header(start, size, frames.size());
+    uint8_t* ptr = m_data + start + 2 * sizeof(uint32_t);
+    for (const auto& frame : frames)
+    {
+      const uint32_t frame_size = frame.size();
+      std::memcpy(ptr, &frame_size, sizeof(frame_size)); ptr += sizeof(frame_size);
+      if (frame_size)
+        std::memcpy(ptr, frame.data(), frame_size);
+      ptr += frame_size;
+    }
+
+    publish(head + size);
+    unlock();
+    return true;
+  }
+//--------------------
+  /**
+    Hand the next record to fn as views into the ring, then release it. The views
+    are only valid during the call. Returns false when nothing arrived in time.
+    Only one thread may receive.
+   */
+  template <typename F>
+  bool receive(F&& fn, std::chrono::milliseconds timeout)
+  {
+    const uint64_t capacity = m_header->capacity;
+    const auto     deadline = shm::deadline_for(timeout);
+    uint64_t       tail     = m_header->tail.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      if (!wait_for_data(tail, deadline))
+        return false;
+
+      uint32_t size, count;
+      const uint8_t* ptr = m_data + tail % capacity;
+      std::memcpy(&size,  ptr,                    sizeof(size));
+      std::memcpy(&count, ptr + sizeof(uint32_t), sizeof(count));
+      if (count != shm::PADDING)
+      {
+        m_frames.resize(count);
+        ptr += 2 * sizeof(uint32_t);
+        for (auto& frame : m_frames)
+        {
+          uint32_t frame_size;
+          std::memcpy(&frame_size, ptr, sizeof(frame_size)); ptr += sizeof(frame_size);
+          frame = {ptr, frame_size};
+          ptr  += frame_size;
+        }
+        fn(const_cast<const frames_t&>(m_frames));
+      }
+      tail += size;
+      release(tail);
+      if (count != shm::PADDING)
+        return true;
+    }
+  }
+//--------------------
+  // Copying receive, for DeserializeIPCMessage and the message classes
+  bool receive(std::vector<ipc_message::byte_buffer>& frames, std::chrono::milliseconds timeout)
+  {
+    return receive([&frames](const frames_t& views)
+    {
+      frames.clear();
+      frames.reserve(views.size());
+      for (const auto& view : views)
+        frames.emplace_back(view.begin(), view.end());
+    }, timeout);
+  }
+//--------------------
+  size_t capacity() const
+  {
+    return m_header->capacity;
+  }
+//--------------------
+  size_t used() const
+  {
+    return m_header->head.load(std::memory_order_acquire) - m_header->tail.load(std::memory_order_acquire);
+  }
+
+private:
+  shm_ring(int fd, size_t size, const std::string& name, bool owner)
+  : m_size(size),
+    m_name(name),
+    m_owner(owner)
+  {
+    void* map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+      if (owner)
+        ::shm_unlink(name.c_str());
+      throw std::runtime_error("Failed to map shared memory ring: " + name);
+    }
+    m_map    = static_cast<uint8_t*>(map);
+    m_header = reinterpret_cast<shm::header_t*>(m_map);
+    m_data   = m_map + shm::HEADER_SIZE;
+  }
+//--------------------
+  void lock()
+  {
+    // A producer died holding the lock. It had not published, so the ring is intact.
+    if (pthread_mutex_lock(&m_header->lock) == EOWNERDEAD)
+      pthread_mutex_consistent(&m_header->lock);
+  }
+//--------------------
+  void unlock()
+  {
+    pthread_mutex_unlock(&m_header->lock);
+  }
+//--------------------
+  void write_header(size_t offset, uint32_t size, uint32_t count)
+  {
+    std::memcpy(m_data + offset,                    &size,  sizeof(size));
+    std::memcpy(m_data + offset + sizeof(uint32_t), &count, sizeof(count));
+  }
+//--------------------
+  static std::chrono::milliseconds slice(std::chrono::steady_clock::time_point deadline,
+                                         std::chrono::steady_clock::time_point now)
+  {
+    return std::min<std::chrono::milliseconds>(shm::WAIT_SLICE,
+      std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) + std::chrono::milliseconds(1));
+  }
+//--------------------
+  // Wait until the consumer has released enough for the ring to reach end
+  bool wait_for_space(uint64_t end, std::chrono::steady_clock::time_point deadline)
+  {
+    auto&          header   = *m_header;
+    const uint64_t capacity = header.capacity;
+    while (end - header.tail.load(std::memory_order_acquire) > capacity)
+    {
+      const uint32_t seq = header.space_seq.load(std::memory_order_seq_cst);
+      header.producers_waiting.store(1, std::memory_order_seq_cst);
+      if (end - header.tail.load(std::memory_order_seq_cst) <= capacity)
+        break;
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline)
+        return false;
+      shm::futex_wait(header.space_seq, seq, slice(deadline, now));
+    }
+    return true;
+  }
+//--------------------
+  bool wait_for_data(uint64_t tail, std::chrono::steady_clock::time_point deadline)
+  {
+    auto& header = *m_header;
+    while (header.head.load(std::memory_order_acquire) == tail)
+    {
+      const uint32_t seq = header.data_seq.load(std::memory_order_seq_cst);
+      header.consumer_waiting.store(1, std::memory_order_seq_cst);
+      if (header.head.load(std::memory_order_seq_cst) != tail)
+        break;
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline)
+        return false;
+      shm::futex_wait(header.data_seq, seq, slice(deadline, now));
+    }
+    return true;
+  }
+//--------------------
+  void publish(uint64_t head)
+  {
+    auto& header = *m_header;
+    header.head.store(head, std::memory_order_seq_cst);
+    header.data_seq.fetch_add(1, std::memory_order_seq_cst);
+    if (header.consumer_waiting.exchange(0, std::memory_order_seq_cst))
+      shm::futex_wake(header.data_seq, 1);
+  }
+//--------------------
+  void release(uint64_t tail)
+  {
+    auto& header = *m_header;
+    header.tail.store(tail, std::memory_order_seq_cst);
+    header.space_seq.fetch_add(1, std::memory_order_seq_cst);
+    if (header.producers_waiting.exchange(0, std::memory_order_seq_cst))
+      shm::futex_wake(header.space_seq, INT_MAX);
+  }
+
+  uint8_t*        m_map;
+  shm::header_t*  m_header;
+  uint8_t*        m_data;
+  size_t          m_size;
+  std::string     m_name;
+  bool            m_owner;
+  frames_t        m_frames;
+};
+} // ns kiq
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KPROTO_X86_SIMD 1
+#endif
+
+namespace kiq {
+/**
+  Text helpers for frame payloads. Scanning is vectorized with SSE2 (part of the
+  x86-64 baseline) and AVX2 where the CPU supports it, chosen once at startup;
+  other targets use the scalar versions, which are kept available for comparison.
+ */
+namespace text {
+static const char        URL_DELIMITER{'>'};
+static const std::string ESCAPED_COMMA{"%2C"};
+//---------------------------------------------------------------------
+namespace scalar {
+inline const char* find(const char* begin, const char* end, char c)
+{
+  while (begin < end && *begin != c)
+    begin++;
+  return begin;
+}
+//--------------------
+inline const char* find_non_ascii(const char* begin, const char* end)
+{
+  while (begin < end && !(static_cast<uint8_t>(*begin) & 0x80))
+    begin++;
+  return begin;
+}
+} // ns scalar
+//---------------------------------------------------------------------
+namespace detail {
+// Length of the UTF-8 sequence at p, or 0 when it is malformed (RFC 3629: no overlongs, surrogates or > U+10FFFF)
+inline size_t utf8_sequence(const uint8_t* p, const uint8_t* end)
+{
+  const uint8_t lead = p[0];
+  if (lead < 0x80)
+    return 1;
+
+  size_t  size;
+  uint8_t low = 0x80, high = 0xBF;
+  if      (lead >= 0xC2 && lead <= 0xDF) size = 2;
+  else if (lead == 0xE0)               { size = 3; low  = 0xA0; }
+  else if (lead == 0xED)               { size = 3; high = 0x9F; }
+  else if (lead >= 0xE1 && lead <= 0xEF) size = 3;
+  else if (lead == 0xF0)               { size = 4; low  = 0x90; }
+  else if (lead == 0xF4)               { size = 4; high = 0x8F; }
+  else if (lead >= 0xF1 && lead <= 0xF3) size = 4;
+  else
+    return 0;
+
+  if (static_cast<size_t>(end - p) < size || p[1] < low || p[1] > high)
+    return 0;
+  for (size_t i = 2; i < size; i++)
+    if ((p[i] & 0xC0) != 0x80)
+      return 0;
+  return size;
+}
+
+#if defined(KPROTO_X86_SIMD)
+inline const char* find_sse2(const char* begin, const char* end, char c)
+{
+  const __m128i needle = _mm_set1_epi8(c);
+  for (; end - begin >= 16; begin += 16)
+    if (const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin)), needle)))
+      return begin + __builtin_ctz(mask);
+  return scalar::find(begin, end, c);
+}
+//--------------------
+__attribute__((target("avx2")))
+inline const char* find_avx2(const char* begin, const char* end, char c)
+{
+  const __m256i needle = _mm256_set1_epi8(c);
+  for (; end - begin >= 32; begin += 32)
+    if (const uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)), needle)))
+      return begin + __builtin_ctz(mask);
+  return find_sse2(begin, end, c);
+}
+//--------------------
+// movemask gathers the high bit of every byte, which is set only outside ASCII
+inline const char* find_non_ascii_sse2(const char* begin, const char* end)
+{
+  for (; end - begin >= 16; begin += 16)
+    if (const int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin))))
+      return begin + __builtin_ctz(mask);
+  return scalar::find_non_ascii(begin, end);
+}
+//--------------------
+__attribute__((target("avx2")))
+inline const char* find_non_ascii_avx2(const char* begin, const char* end)
+{
+  for (; end - begin >= 32; begin += 32)
+    if (const uint32_t mask = _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin))))
+      return begin + __builtin_ctz(mask);
+  return find_non_ascii_sse2(begin, end);
+}
+//--------------------
+inline bool has_avx2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+using find_fn           = const char* (*)(const char*, const char*, char);
+using find_non_ascii_fn = const char* (*)(const char*, const char*);
+inline const find_fn           find_impl           = has_avx2() ? find_avx2           : find_sse2;
+inline const find_non_ascii_fn find_non_ascii_impl = has_avx2() ? find_non_ascii_avx2 : find_non_ascii_sse2;
+#endif
+} // ns detail
+//---------------------------------------------------------------------
+inline const char* find(const char* begin, const char* end, char c)
+{
+#if defined(KPROTO_X86_SIMD)
+  return detail::find_impl(begin, end, c);
+#else
+  return scalar::find(begin, end, c);
+#endif
+}
+//---------------------------------------------------------------------
+inline const char* find_non_ascii(const char* begin, const char* end)
+{
+#if defined(KPROTO_X86_SIMD)
+  return detail::find_non_ascii_impl(begin, end);
+#else
+  return scalar::find_non_ascii(begin, end);
+#endif
+}
+//---------------------------------------------------------------------
+namespace detail {
+template <auto Find>
+std::vector<std::string_view> split(std::string_view s, char delimiter)
+{
+  std::vector<std::string_view> parts;
+  const char* begin = s.data();
+  const char* end   = s.data() + s.size();
+  while (begin < end)
+  {
+    const char* next = Find(begin, end, delimiter);
+    if (next != begin)
+      parts.emplace_back(begin, next - begin);
+    begin = next + 1;
+  }
+  return parts;
+}
+//--------------------
+template <auto FindNonAscii>
+bool validate_utf8(const char* begin, const char* end)
+{
+  while ((begin = FindNonAscii(begin, end)) < end)
+    do // Stay scalar while the text remains non-ASCII
+    {
+      const size_t size = utf8_sequence(reinterpret_cast<const uint8_t*>(begin), reinterpret_cast<const uint8_t*>(end));
+      if (!size)
+        return false;
+      begin += size;
+    }
+    while (begin < end && (static_cast<uint8_t>(*begin) & 0x80));
+  return true;
+}
+//--------------------
+template <auto Find>
+size_t unescape_commas(char* data, size_t size)
+{
+  const char* read  = data;
+  const char* end   = data + size;
+  char*       write = data;
+  for (;;)
+  {
+    const char*  match = Find(read, end, '%');
+    const size_t run   = match - read;
+    if (write != read)
+      std::memmove(write, read, run);
+    write += run;
+    if (match == end)
+      break;
+
+    if (end - match >= 3 && match[1] == ESCAPED_COMMA[1] && match[2] == ESCAPED_COMMA[2])
+    {
+      *write++ = ',';
+      read     = match + ESCAPED_COMMA.size();
+    }
+    else
+    {
+      *write++ = '%';
+      read     = match + 1;
+    }
+  }
+  return write - data;
+}
+} // ns detail
+//---------------------------------------------------------------------
+namespace scalar {
+inline std::vector<std::string_view> split_urls(std::string_view urls, char delimiter = URL_DELIMITER)
+{
+  return detail::split<scalar::find>(urls, delimiter);
+}
+//--------------------
+inline bool validate_utf8(std::string_view s)
+{
+  return detail::validate_utf8<scalar::find_non_ascii>(s.data(), s.data() + s.size());
+}
+//--------------------
+inline size_t unescape_commas(char* data, size_t size)
+{
+  return detail::unescape_commas<scalar::find>(data, size);
+}
+} // ns scalar
+//---------------------------------------------------------------------
+// Views into the frame: the frame must outlive the result. Empty entries are skipped.
+inline std::vector<std::string_view> split_urls(std::string_view urls, char delimiter = URL_DELIMITER)
+{
+  return detail::split<text::find>(urls, delimiter);
+}
+//---------------------------------------------------------------------
+inline bool validate_utf8(std::string_view s)
+{
+  return detail::validate_utf8<text::find_non_ascii>(s.data(), s.data() + s.size());
+}
+//---------------------------------------------------------------------
+// Replace every '%2C' with ',' in place; returns the new size
+inline size_t unescape_commas(char* data, size_t size)
+{
+  return detail::unescape_commas<text::find>(data, size);
+}
+//--------------------
+inline void unescape_commas(std::string& s)
+{
+  s.resize(unescape_commas(s.data(), s.size()));
+}
+//--------------------
+inline void unescape_commas(std::vector<uint8_t>& buffer)
+{
+  buffer.resize(unescape_commas(reinterpret_cast<char*>(buffer.data()), buffer.size()));
+}
+} // ns text
+} // ns kiq
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ipc.hpp"
+#include "ipc_structs.hpp"
+
+namespace kiq {
+/**
+  Incremental delivery of long outputs (ie: REQUEST_GENERATE_AI responses).
+  Rather than appending each piece to the text and re-sending all of it as a
+  platform_info, the producer sends every piece once as a stream_chunk. The
+  receiver reassembles the pieces in sequence into a rope. Total work is O(n)
+  in the output length, and each piece can be shown as soon as it arrives.
+ */
+//---------------------------------------------------------------------
+// Text held as the received pieces; only joined on request
+class rope
+{
+public:
+  void append(ipc_message::byte_buffer&& piece)
+  {
+    m_size += piece.size();
+    if (!piece.empty())
+      m_pieces.push_back(std::move(piece));
+  }
+//--------------------
+  size_t size() const
+  {
+    return m_size;
+  }
+//--------------------
+  bool empty() const
+  {
+    return m_size == 0;
+  }
+//--------------------
+  template <typename F>
+  void for_each(F&& fn) const
+  {
+    for (const auto& piece : m_pieces)
+      fn(std::string_view{reinterpret_cast<const char*>(piece.data()), piece.size()});
+  }
+//--------------------
+  std::string to_string() const
+  {
+    std::string text;
+    text.reserve(m_size);
+    for_each([&text](std::string_view piece) { text += piece; });
+    return text;
+  }
+
+private:
+  std::vector<ipc_message::byte_buffer> m_pieces;
+  size_t                                m_size{0};
+};
+//---------------------------------------------------------------------
+// Producer side: numbers the chunks of one stream
+class stream_writer
+{
+public:
+  stream_writer(const std::string& platform, const std::string& id, const std::string& type = REQUEST_GENERATE_AI)
+  : m_platform(platform),
+    m_id(id),
+    m_type(type)
+  {}
+//--------------------
+  ipc_message::u_ipc_msg_ptr next(frame_arg delta)
+  {
+    return std::make_unique<stream_chunk>(m_platform, m_id, m_type, m_seq++, std::move(delta));
+  }
+//--------------------
+  ipc_message::u_ipc_msg_ptr finish(frame_arg delta = "")
+  {
+    return std::make_unique<stream_chunk>(m_platform, m_id, m_type, m_seq++, std::move(delta), true);
+  }
+//--------------------
+  uint32_t sent() const
+  {
+    return m_seq;
+  }
+
+private:
+  std::string m_platform;
+  std::string m_id;
+  std::string m_type;
+  uint32_t    m_seq{0};
+};
+//---------------------------------------------------------------------
+struct stream_config
+{
+size_t                    max_streams {1024};                   // least recently updated are dropped beyond this
+size_t                    max_buffered{4 * 1024 * 1024};        // out-of-order bytes held per stream before it is dropped
+std::chrono::milliseconds idle_timeout{std::chrono::minutes(5)}; // streams not updated for this long are dropped
+size_t                    max_finished{4096};                   // finished or dropped streams remembered, to ignore late chunks
+};
+//---------------------------------------------------------------------
+/**
+  Receiver side: reorders chunks per (platform, id), drops duplicates, and
+  hands each in-order delta to on_delta before appending it to the stream's
+  rope. add() returns true once the end of the stream has been delivered;
+  take() then yields the complete text.
+
+  A peer cannot make the assembler hold unbounded state: streams beyond
+  max_streams, idle for idle_timeout, or buffering more than max_buffered
+  out-of-order bytes are dropped (completed streams included, when not taken
+  in time). The keys of taken and dropped streams are remembered, so chunks
+  arriving for them late are ignored rather than opening a new stream.
+ */
+class stream_assembler
+{
+public:
+  using key_t    = std::pair<std::string, std::string>;
+  using delta_fn = std::function<void(const key_t&, std::string_view)>;
+  using clock_t  = std::chrono::steady_clock;
+//--------------------
+  explicit stream_assembler(delta_fn on_delta = nullptr, const stream_config& config = stream_config{})
+  : m_on_delta(on_delta),
+    m_config(config)
+  {}
+//--------------------
+  bool add(stream_chunk& chunk)
+  {
+    const auto now = clock_t::now();
+    expire(now);
+
+    key_t key{chunk.platform(), chunk.id()};
+    if (m_finished.count(key))
+      return false;
+
+    auto [entry, created] = m_streams.try_emplace(std::move(key));
+    auto&          stream = entry->second;
+    const uint32_t seq    = chunk.seq();
+    if (created)
+    {
+      m_order.push_front(&entry->first);
+      stream.position = m_order.begin();
+      if (m_streams.size() > std::max<size_t>(1, m_config.max_streams))
+        drop(m_streams.find(*m_order.back()));
+    }
+    else
+      m_order.splice(m_order.begin(), m_order, stream.position);
+    stream.updated = now;
+
+    if (seq < stream.next || stream.pending.count(seq))
+      return stream.complete;
+
+    auto delta = chunk.take_delta();
+    if (seq != stream.next)
+    {
+      stream.buffered += delta.size() + PENDING_COST;
+      if (stream.buffered > m_config.max_buffered)
+      {
+        drop(entry);
+        return false;
+      }
+    }
+
+    stream.pending.emplace(seq, pending_t{std::move(delta), chunk.eos()});
+    for (auto it = stream.pending.begin(); it != stream.pending.end() && it->first == stream.next;)
+    {
+      auto& [delta, eos] = it->second;
+      if (it->first != seq)
+        stream.buffered -= delta.size() + PENDING_COST;
+      if (m_on_delta)
+        m_on_delta(entry->first, std::string_view{reinterpret_cast<const char*>(delta.data()), delta.size()});
+      stream.text.append(std::move(delta));
+      stream.complete |= eos;
+      stream.next++;
+      it = stream.pending.erase(it);
+    }
+    return stream.complete;
+  }
+//--------------------
+  // Remove a stream and return its text so far
+  rope take(const std::string& platform, const std::string& id)
+  {
+    rope text;
+    if (auto it = m_streams.find(key_t{platform, id}); it != m_streams.end())
+    {
+      text = std::move(it->second.text);
+      forget(it);
+    }
+    return text;
+  }
+//--------------------
+  size_t active() const
+  {
+    return m_streams.size();
+  }
+//--------------------
+  // Streams dropped for exceeding a limit or going idle
+  size_t dropped() const
+  {
+    return m_dropped;
+  }
+
+private:
+  static const size_t PENDING_COST{64}; // counted per buffered chunk, so empty ones are not free
+
+  struct pending_t
+  {
+  ipc_message::byte_buffer delta;
+  bool                     eos;
+  };
+//--------------------
+  struct stream_t
+  {
+  rope                                  text;
+  std::map<uint32_t, pending_t>         pending;
+  uint32_t                              next{0};
+  bool                                  complete{false};
+  size_t                                buffered{0};
+  clock_t::time_point                   updated;
+  std::list<const key_t*>::iterator     position;
+  };
+  using streams_t = std::map<key_t, stream_t>;
+//--------------------
+  // Forget a stream, remembering its key so late chunks are ignored
+  void forget(streams_t::iterator it)
+  {
+    remember(it->first);
+    m_order.erase(it->second.position);
+    m_streams.erase(it);
+  }
+//--------------------
+  void drop(streams_t::iterator it)
+  {
+    m_dropped++;
+    forget(it);
+  }
+//--------------------
+  void remember(const key_t& key)
+  {
+    if (!m_finished.insert(key).second)
+      return;
+    m_finished_order.push_back(key);
+    while (m_finished_order.size() > m_config.max_finished)
+    {
+      m_finished.erase(m_finished_order.front());
+      m_finished_order.pop_front();
+    }
+  }
+//--------------------
+  void expire(clock_t::time_point now)
+  {
+    while (!m_order.empty())
+    {
+      auto it = m_streams.find(*m_order.back());
+      if (now - it->second.updated < m_config.idle_timeout)
+        break;
+      drop(it);
+    }
+  }
+
+  streams_t               m_streams;
+  std::list<const key_t*> m_order;          // most recently updated first
+  std::set<key_t>         m_finished;
+  std::deque<key_t>       m_finished_order;
+  delta_fn                m_on_delta;
+  stream_config           m_config;
+  size_t                  m_dropped{0};
+};
+} // ns kiq
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ipc.hpp"
+
+namespace kiq {
+/**
+  Stripes outbound messages across a pool of sockets served by several ZeroMQ
+  IO threads. The stripe is chosen from the platform frame, so every message
+  for a given platform leaves through the same socket and keeps its order.
+  Messages without a platform frame (keepalive, status, blob) use the first stripe.
+  io_threads is clamped to 1-64, the span of a socket's affinity mask.
+ */
+class striped_transmitter
+{
+public:
+  using socket_setup_fn = std::function<void(zmq::socket_t&)>;
+//--------------------
+  struct stripe_stats
+  {
+  size_t messages;
+  size_t bytes;
+  };
+//--------------------
+  struct stats
+  {
+  size_t                    messages{0};
+  size_t                    bytes{0};
+  std::vector<stripe_stats> stripes;
+  };
+//--------------------
+  striped_transmitter(const std::vector<std::string>& endpoints,
+                      size_t                          sockets    = 4,
+                      int                             io_threads = 4,
+                      zmq::socket_type                type       = zmq::socket_type::dealer,
+                      socket_setup_fn                 setup      = nullptr)
+  : m_context(std::clamp(io_threads, 1, MAX_IO_THREADS)),
+    m_stripes(std::max<size_t>(1, sockets))
+  {
+    io_threads = std::clamp(io_threads, 1, MAX_IO_THREADS);
+    auto io    = threading::get_io();
+    io.threads = io_threads;
+    threading::configure(m_context, io);
+
+    for (size_t i = 0; i < m_stripes.size(); i++)
+    {
+      auto& stripe  = m_stripes[i];
+      stripe.socket = zmq::socket_t{m_context, type};
+      stripe.socket.set(zmq::sockopt::linger,   0);
+      stripe.socket.set(zmq::sockopt::affinity, uint64_t{1} << (i % io_threads));
+      if (setup)
+        setup(stripe.socket);
+      stripe.socket.connect(endpoints.at(i % endpoints.size()));
+    }
+  }
+//--------------------
+  striped_transmitter(const std::string& endpoint, size_t sockets = 4, int io_threads = 4)
+  : striped_transmitter(std::vector<std::string>{endpoint}, sockets, io_threads)
+  {}
+//--------------------
+  void send_ipc_message(ipc_message::u_ipc_msg_ptr message)
+  {
+    auto&  payload = message->m_frames;
+    auto&  stripe  = m_stripes[stripe_for(payload)];
+
+    if (m_tap)
+      m_tap(payload);
+    count_frames(metrics::direction::out, payload);
+
+    size_t bytes;
+    {
+      std::lock_guard<std::mutex> lock(stripe.mutex);
+      bytes = send_ipc_frames(stripe.socket, std::move(payload));
+    }
+    stripe.messages.fetch_add(1,     std::memory_order_relaxed);
+    stripe.bytes   .fetch_add(bytes, std::memory_order_relaxed);
+  }
+//--------------------
+  size_t stripe_for(const std::vector<ipc_message::byte_buffer>& frames) const
+  {
+    if (frames.size() <= constants::index::PLATFORM || frames[constants::index::TYPE].empty() ||
+        !has_platform_frame(frames[constants::index::TYPE][0]))
+      return 0;
+
+    const auto& platform = frames[constants::index::PLATFORM];
+    return std::hash<std::string_view>{}({reinterpret_cast<const char*>(platform.data()), platform.size()}) %
+           m_stripes.size();
+  }
+//--------------------
+  void set_tap(frame_tap_fn fn)
+  {
+    m_tap = fn;
+  }
+//--------------------
+  size_t size() const
+  {
+    return m_stripes.size();
+  }
+//--------------------
+  stats metrics() const
+  {
+    stats result;
+    for (const auto& stripe : m_stripes)
+    {
+      const stripe_stats s{stripe.messages.load(std::memory_order_relaxed), stripe.bytes.load(std::memory_order_relaxed)};
+      result.messages += s.messages;
+      result.bytes    += s.bytes;
+      result.stripes.push_back(s);
+    }
+    return result;
+  }
+
+private:
+  static constexpr int MAX_IO_THREADS{64};
+//--------------------
+  struct stripe_t
+  {
+  zmq::socket_t       socket;
+  std::mutex          mutex;
+  std::atomic<size_t> messages{0};
+  std::atomic<size_t> bytes{0};
+  };
+
+  zmq::context_t        m_context;
+  std::vector<stripe_t> m_stripes;
+  frame_tap_fn          m_tap;
+};
+} // ns kiq
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ipc.hpp"
+
+namespace kiq {
+/**
+  Incremental task logs. A long-running task (ie: EXECUTE_PROCESS, KAI_TASK)
+  sends its output as task_log chunks, each tagged with the offset at which it
+  starts in the task's whole log, instead of re-sending a task message with the
+  full log on every update. The receiver keeps a bounded tail of every task's
+  log in a task_log_store.
+ */
+//---------------------------------------------------------------------
+// Sender side: tracks how much of one task's log has been sent
+class task_log_writer
+{
+public:
+  explicit task_log_writer(const std::string& id, uint64_t offset = 0)
+  : m_id(id),
+    m_offset(offset)
+  {}
+//--------------------
+  // Chunk for output produced since the last call
+  ipc_message::u_ipc_msg_ptr append(frame_arg chunk)
+  {
+    auto message = std::make_unique<task_log>(m_id, m_offset, std::move(chunk));
+    m_offset     = message->end();
+    return message;
+  }
+//--------------------
+  /**
+    Chunk for whatever the full log holds beyond what was already sent, for
+    callers that accumulate the log themselves; nullptr when nothing is new.
+    A log shorter than what was sent is taken to have restarted. Offsets keep
+    increasing across the restart, so receivers append the new log after the
+    old one rather than discarding it as a resend.
+   */
+  ipc_message::u_ipc_msg_ptr update(std::string_view log)
+  {
+    if (log.size() < m_offset - m_base)
+      m_base = m_offset;
+    const uint64_t sent = m_offset - m_base;
+    if (log.size() == sent)
+      return nullptr;
+    return append(log.substr(sent));
+  }
+//--------------------
+  uint64_t offset() const
+  {
+    return m_offset;
+  }
+
+private:
+  std::string m_id;
+  uint64_t    m_offset;
+  uint64_t    m_base{0}; // offset at which the log passed to update() starts
+};
+//---------------------------------------------------------------------
+// The last capacity bytes of a log, addressed by offset in the whole log
+class log_ring
+{
+public:
+  explicit log_ring(size_t capacity)
+  : m_buffer(std::max<size_t>(1, capacity))
+  {}
+//--------------------
+  /**
+    Place data at offset. Data already held is skipped, so duplicates and
+    overlapping resends are harmless. A gap (chunks lost, or the receiver
+    joined late) discards the older bytes, which are no longer contiguous.
+    Returns the number of new bytes.
+   */
+  size_t write(uint64_t offset, const uint8_t* data, size_t size)
+  {
+    if (offset + size <= m_end)
+      return 0;
+    if (offset > m_end)
+    {
+      m_missing += offset - m_end;
+      m_start    = offset;
+      m_end      = offset;
+    }
+
+    const size_t skip = m_end - offset;
+    data += skip;
+    size -= skip;
+    const size_t added    = size;
+    const size_t capacity = m_buffer.size();
+    if (size > capacity)
+    {
+      data  += size - capacity;
+      m_end += size - capacity;
+      size   = capacity;
+    }
+
+    const size_t pos   = m_end % capacity;
+    const size_t first = std::min(size, capacity - pos);
+    std::memcpy(m_buffer.data() + pos, data, first);
+    std::memcpy(m_buffer.data(),       data + first, size - first);
+    m_end  += size;
+    m_start = std::max(m_start, (m_end > capacity) ? m_end - capacity : 0);
+    return added;
+  }
+//--------------------
+  // Up to max_bytes from offset, clamped to what is held
+  std::string read(uint64_t offset, size_t max_bytes = SIZE_MAX) const
+  {
+    offset = std::clamp(offset, m_start, m_end);
+    const size_t capacity = m_buffer.size();
+    const size_t size     = std::min<uint64_t>(m_end - offset, max_bytes);
+    const size_t pos      = offset % capacity;
+    const size_t first    = std::min(size, capacity - pos);
+
+    std::string text;
+    text.reserve(size);
+    text.append(m_buffer.data() + pos, first);
+    text.append(m_buffer.data(),       size - first);
+    return text;
+  }
+//--------------------
+  std::string tail(size_t max_bytes) const
+  {
+    return read((m_end - m_start > max_bytes) ? m_end - max_bytes : m_start);
+  }
+//--------------------
+  // Offset of the oldest byte held
+  uint64_t start() const
+  {
+    return m_start;
+  }
+//--------------------
+  // Offset just past the newest byte, ie: the total log length seen
+  uint64_t end() const
+  {
+    return m_end;
+  }
+//--------------------
+  // Bytes never received because of gaps
+  uint64_t missing() const
+  {
+    return m_missing;
+  }
+
+private:
+  std::vector<char> m_buffer;
+  uint64_t          m_start{0};
+  uint64_t          m_end{0};
+  uint64_t          m_missing{0};
+};
+//---------------------------------------------------------------------
+struct task_log_config
+{
+size_t capacity {1024 * 1024}; // bytes of tail kept per task
+size_t max_tasks{256};         // least recently updated tasks are dropped beyond this
+};
+//---------------------------------------------------------------------
+// Receiver side: one log_ring per task id, bounded in count
+class task_log_store
+{
+public:
+  explicit task_log_store(const task_log_config& config = task_log_config{})
+  : m_config(config)
+  {}
+//--------------------
+  // Returns the number of new bytes
+  size_t add(const task_log& chunk)
+  {
+    const auto& data = chunk.chunk();
+    return ring(chunk.id()).write(chunk.offset(), data.data(), data.size());
+  }
+//--------------------
+  std::string tail(const std::string& id, size_t max_bytes = SIZE_MAX) const
+  {
+    const auto* log = find(id);
+    return (log) ? log->tail(max_bytes) : "";
+  }
+//--------------------
+  // For followers polling with the offset they have read up to
+  std::string read(const std::string& id, uint64_t offset, size_t max_bytes = SIZE_MAX) const
+  {
+    const auto* log = find(id);
+    return (log) ? log->read(offset, max_bytes) : "";
+  }
+//--------------------
+  const log_ring* find(const std::string& id) const
+  {
+    auto it = m_logs.find(id);
+    return (it != m_logs.end()) ? &it->second.ring : nullptr;
+  }
+//--------------------
+  void erase(const std::string& id)
+  {
+    if (auto it = m_logs.find(id); it != m_logs.end())
+    {
+      m_order.erase(it->second.position);
+      m_logs.erase(it);
+    }
+  }
+//--------------------
+  size_t size() const
+  {
+    return m_logs.size();
+  }
+
+private:
+  struct entry_t
+  {
+  log_ring                         ring;
+  std::list<std::string>::iterator position;
+  };
+//--------------------
+  log_ring& ring(const std::string& id)
+  {
+    if (auto it = m_logs.find(id); it != m_logs.end())
+    {
+      m_order.splice(m_order.begin(), m_order, it->second.position);
+      return it->second.ring;
+    }
+
+    if (m_logs.size() >= std::max<size_t>(1, m_config.max_tasks))
+    {
+      m_logs.erase(m_order.back());
+      m_order.pop_back();
+    }
+    m_order.push_front(id);
+    return m_logs.emplace(id, entry_t{log_ring{m_config.capacity}, m_order.begin()}).first->second.ring;
+  }
+
+  task_log_config                          m_config;
+  std::unordered_map<std::string, entry_t> m_logs;
+  std::list<std::string>                   m_order; // most recently updated first
+};
+} // ns kiq
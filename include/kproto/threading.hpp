@@ -0,0 +1,293 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <zmq.hpp>
+
+namespace kiq {
+/**
+  Placement of the threads kproto starts. Every such thread takes a role and
+  applies that role's thread_config as it starts:
+
+    session   session_daemon's sweep
+    send      priority_transmitter's send thread
+    flush     outbox_log's group-commit flusher
+    dispatch  application workers started through threading::spawn()
+
+  Set the configs before constructing the objects that own the threads. A
+  thread can be pinned to a list of CPUs, or to the CPUs of one NUMA node; in
+  the latter case it also prefers that node's memory, so the queues and buffers
+  it allocates (or first touches) stay local. ZeroMQ's IO threads are placed
+  with configure(), which must run before the context's first socket is made.
+
+  Settings that cannot be applied (ie: SCHED_FIFO without CAP_SYS_NICE) are
+  reported through log_fn and otherwise ignored.
+ */
+struct thread_config
+{
+std::vector<int> cpus;           // pin to these CPUs; empty leaves placement to the OS
+int              numa_node  {-1}; // pin to this node's CPUs (when cpus is empty) and prefer its memory
+int              rt_priority{0};  // SCHED_FIFO priority 1-99; 0 keeps the default policy
+std::string      name;           // defaults to the role's name (at most 15 characters are kept)
+};
+//---------------------------------------------------------------------
+struct io_config
+{
+int              threads    {1};
+std::vector<int> cpus;
+int              rt_priority{0};
+};
+//---------------------------------------------------------------------
+namespace threading {
+enum class role : uint8_t
+{
+  session  = 0x00,
+  send     = 0x01,
+  flush    = 0x02,
+  dispatch = 0x03
+};
+static const size_t ROLES{4};
+static const char*  ROLE_NAMES[ROLES]{"kp-session", "kp-send", "kp-flush", "kp-dispatch"};
+//---------------------------------------------------------------------
+// Linux cpulist format, ie: "0-3,8,10-11"
+inline std::vector<int> parse_cpulist(std::string_view list)
+{
+  std::vector<int>  cpus;
+  std::stringstream ss{std::string{list}};
+  std::string       range;
+  while (std::getline(ss, range, ','))
+  {
+    if (range.empty() || range == "\n")
+      continue;
+    const auto dash  = range.find('-');
+    const int  first = std::stoi(range.substr(0, dash));
+    const int  last  = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+//---------------------------------------------------------------------
+inline std::vector<int> node_cpus(int node)
+{
+  std::ifstream file{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+  std::string   list;
+  std::getline(file, list);
+  return parse_cpulist(list);
+}
+//---------------------------------------------------------------------
+// Nodes with CPUs; a single node 0 where NUMA is absent
+inline std::vector<int> nodes()
+{
+  std::ifstream file{"/sys/devices/system/node/has_cpu"};
+  std::string   list;
+  std::getline(file, list);
+  auto ids = parse_cpulist(list);
+  return (ids.empty()) ? std::vector<int>{0} : ids;
+}
+//---------------------------------------------------------------------
+inline int node_of(int cpu)
+{
+  for (const int node : nodes())
+    for (const int node_cpu : node_cpus(node))
+      if (node_cpu == cpu)
+        return node;
+  return 0;
+}
+//---------------------------------------------------------------------
+namespace detail {
+struct state_t
+{
+std::mutex                          mutex;
+std::array<thread_config, ROLES>    configs;
+io_config                           io;
+std::function<void(const char*)>    log{[](const char*) {}};
+};
+//--------------------
+inline state_t& state()
+{
+  static state_t shared;
+  return shared;
+}
+//--------------------
+inline bool prefer_node(int node)
+{
+  unsigned long mask[16]{};
+  if (node < 0 || static_cast<size_t>(node) >= sizeof(mask) * 8)
+    return false;
+  mask[node / (sizeof(unsigned long) * 8)] |= 1UL << (node % (sizeof(unsigned long) * 8));
+  return ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) == 0;
+}
+//--------------------
+inline void log(const std::string& message)
+{
+  std::function<void(const char*)> log_fn;
+  {
+    std::lock_guard<std::mutex> lock(state().mutex);
+    log_fn = state().log;
+  }
+  log_fn(message.c_str());
+}
+} // ns detail
+//---------------------------------------------------------------------
+inline void set_log_fn(std::function<void(const char*)> fn)
+{
+  std::lock_guard<std::mutex> lock(detail::state().mutex);
+  detail::state().log = std::move(fn);
+}
+//---------------------------------------------------------------------
+inline void set(role selected, thread_config config)
+{
+  std::lock_guard<std::mutex> lock(detail::state().mutex);
+  detail::state().configs[static_cast<size_t>(selected)] = std::move(config);
+}
+//---------------------------------------------------------------------
+inline thread_config get(role selected)
+{
+  std::lock_guard<std::mutex> lock(detail::state().mutex);
+  return detail::state().configs[static_cast<size_t>(selected)];
+}
+//---------------------------------------------------------------------
+inline void set_io(io_config config)
+{
+  std::lock_guard<std::mutex> lock(detail::state().mutex);
+  detail::state().io = std::move(config);
+}
+//---------------------------------------------------------------------
+inline io_config get_io()
+{
+  std::lock_guard<std::mutex> lock(detail::state().mutex);
+  return detail::state().io;
+}
+//---------------------------------------------------------------------
+// Apply config to the calling thread; returns what could not be applied, if anything
+inline std::string apply(const thread_config& config)
+{
+  std::string failed;
+  const auto  cpus = (config.cpus.empty() && config.numa_node >= 0) ? node_cpus(config.numa_node) : config.cpus;
+  if (!cpus.empty())
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus)
+      if (cpu >= 0 && cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+    if (const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+      failed += std::string{"affinity: "} + std::strerror(error) + "; ";
+  }
+
+  if (config.numa_node >= 0 && !detail::prefer_node(config.numa_node))
+    failed += std::string{"memory policy: "} + std::strerror(errno) + "; ";
+
+  if (config.rt_priority > 0)
+  {
+    sched_param param{};
+    param.sched_priority = config.rt_priority;
+    if (const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+      failed += std::string{"SCHED_FIFO: "} + std::strerror(error) + "; ";
+  }
+
+  if (!config.name.empty())
+    pthread_setname_np(pthread_self(), config.name.substr(0, 15).c_str());
+  return failed;
+}
+//---------------------------------------------------------------------
+// Apply config to the calling thread and log whatever could not be applied
+inline void enter(thread_config config, const char* fallback_name = "kp-worker")
+{
+  if (config.name.empty())
+    config.name = fallback_name;
+
+  if (const auto failed = apply(config); !failed.empty())
+    detail::log("Thread placement for " + config.name + " not fully applied: " + failed.substr(0, failed.size() - 2));
+}
+//---------------------------------------------------------------------
+// Called first thing by each thread kproto starts
+inline void enter(role selected)
+{
+  enter(get(selected), ROLE_NAMES[static_cast<size_t>(selected)]);
+}
+//---------------------------------------------------------------------
+// The role's config is read by the new thread as it starts
+template <typename F, typename... Args>
+std::thread spawn(role selected, F&& fn, Args&&... args)
+{
+  return std::thread([selected, fn = std::forward<F>(fn)](auto&&... args) mutable
+  {
+    enter(selected);
+    std::invoke(fn, std::forward<decltype(args)>(args)...);
+  }, std::forward<Args>(args)...);
+}
+//---------------------------------------------------------------------
+// For workers that each need their own placement, ie: one per core
+template <typename F, typename... Args>
+std::thread spawn(thread_config config, F&& fn, Args&&... args)
+{
+  return std::thread([config = std::move(config), fn = std::forward<F>(fn)](auto&&... args) mutable
+  {
+    enter(config);
+    std::invoke(fn, std::forward<decltype(args)>(args)...);
+  }, std::forward<Args>(args)...);
+}
+//---------------------------------------------------------------------
+// Whether this process may use SCHED_FIFO at priority, tried on the calling thread
+inline bool can_use_fifo(int priority)
+{
+  int         policy;
+  sched_param previous{};
+  pthread_getschedparam(pthread_self(), &policy, &previous);
+
+  sched_param param{};
+  param.sched_priority = priority;
+  if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+    return false;
+  pthread_setschedparam(pthread_self(), policy, &previous);
+  return true;
+}
+//---------------------------------------------------------------------
+/**
+  Place a context's IO threads. Must precede the context's first socket.
+  libzmq aborts when it cannot apply affinity or a scheduling policy to its
+  threads, so CPUs this process may not run on are dropped and rt_priority is
+  first tried on the calling thread; whatever is dropped is logged.
+ */
+inline void configure(zmq::context_t& context, const io_config& config = get_io())
+{
+  context.set(zmq::ctxopt::io_threads, config.threads);
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+  for (const int cpu : config.cpus)
+    if (cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+      context.set(zmq::ctxopt::thread_affinity_cpu_add, cpu);
+    else
+      detail::log("CPU " + std::to_string(cpu) + " unavailable; not used for ZeroMQ IO threads");
+
+  if (config.rt_priority <= 0)
+    return;
+  if (!can_use_fifo(config.rt_priority))
+  {
+    detail::log("SCHED_FIFO priority " + std::to_string(config.rt_priority) +
+                " not permitted; ZeroMQ IO threads keep the default policy");
+    return;
+  }
+  context.set(zmq::ctxopt::thread_sched_policy, SCHED_FIFO);
+  context.set(zmq::ctxopt::thread_priority,     config.rt_priority);
+}
+} // ns threading
+} // ns kiq
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ipc.hpp"
+#include "shm.hpp"
+
+namespace kiq {
+/**
+  One direction of a message pipe, chosen by endpoint scheme:
+
+    shm://name  shared memory ring (same host only; see shm.hpp)
+    anything    passed to zmq (inproc://, ipc://, tcp://)
+
+  The side that binds receives; the side that connects sends. A shm ring only
+  carries messages one way, so a peer expecting replies binds its own endpoint.
+ */
+class ipc_transport
+{
+public:
+  virtual ~ipc_transport() = default;
+  virtual size_t send(const std::vector<ipc_message::byte_buffer>& frames)                     = 0;
+  virtual bool   recv(std::vector<ipc_message::byte_buffer>& frames, std::chrono::milliseconds) = 0;
+//--------------------
+  ipc_message::u_ipc_msg_ptr recv(std::chrono::milliseconds timeout)
+  {
+    std::vector<ipc_message::byte_buffer> frames;
+    return (recv(frames, timeout)) ? DeserializeIPCMessage(std::move(frames)) : nullptr;
+  }
+};
+//---------------------------------------------------------------------
+class zmq_transport : public ipc_transport
+{
+public:
+  using ipc_transport::recv;
+//--------------------
+  zmq_transport(zmq::context_t& context, const std::string& endpoint, bool bind, zmq::socket_type type)
+  : m_socket(context, type)
+  {
+    m_socket.set(zmq::sockopt::linger, 0);
+    if (bind)
+      m_socket.bind(endpoint);
+    else
+      m_socket.connect(endpoint);
+  }
+//--------------------
+  size_t send(const std::vector<ipc_message::byte_buffer>& frames) override
+  {
+    return send_ipc_frames(m_socket, frames);
+  }
+//--------------------
+  bool recv(std::vector<ipc_message::byte_buffer>& frames, std::chrono::milliseconds timeout) override
+  {
+    zmq::pollitem_t item{m_socket.handle(), 0, ZMQ_POLLIN, 0};
+    if (!zmq::poll(&item, 1, timeout))
+      return false;
+
+    frames.clear();
+    zmq::message_t message;
+    do
+    {
+      if (!m_socket.recv(message, zmq::recv_flags::none))
+        return false;
+      const auto* data = static_cast<const uint8_t*>(message.data());
+      frames.emplace_back(data, data + message.size());
+    }
+    while (message.more());
+    return true;
+  }
+//--------------------
+  zmq::socket_t& socket()
+  {
+    return m_socket;
+  }
+
+private:
+  zmq::socket_t m_socket;
+};
+//---------------------------------------------------------------------
+class shm_transport : public ipc_transport
+{
+public:
+  using ipc_transport::recv;
+//--------------------
+  shm_transport(const std::string&        name,
+                bool                      bind,
+                size_t                    capacity     = shm::CAPACITY,
+                std::chrono::milliseconds send_timeout = shm::SEND_TIMEOUT)
+  : m_ring((bind) ? shm_ring::create(name, capacity) : shm_ring::open(name)),
+    m_send_timeout(send_timeout)
+  {}
+//--------------------
+  // Throws when the consumer has not made room within the send timeout
+  size_t send(const std::vector<ipc_message::byte_buffer>& frames) override
+  {
+    if (!m_ring->send(frames, m_send_timeout))
+      throw std::runtime_error("Timed out sending to shared memory ring");
+    size_t bytes = 0;
+    for (const auto& frame : frames)
+      bytes += frame.size();
+    return bytes;
+  }
+//--------------------
+  bool recv(std::vector<ipc_message::byte_buffer>& frames, std::chrono::milliseconds timeout) override
+  {
+    return m_ring->receive(frames, timeout);
+  }
+//--------------------
+  // Zero-copy receive: fn sees the frames in place, valid only for the call
+  template <typename F>
+  bool recv_view(F&& fn, std::chrono::milliseconds timeout)
+  {
+    return m_ring->receive(std::forward<F>(fn), timeout);
+  }
+//--------------------
+  shm_ring& ring()
+  {
+    return *m_ring;
+  }
+
+private:
+  std::unique_ptr<shm_ring> m_ring;
+  std::chrono::milliseconds m_send_timeout;
+};
+//---------------------------------------------------------------------
+static const std::string_view SHM_SCHEME{"shm://"};
+//---------------------------------------------------------------------
+inline std::unique_ptr<ipc_transport> make_transport(zmq::context_t&    context,
+                                                     const std::string& endpoint,
+                                                     bool               bind,
+                                                     zmq::socket_type   type = zmq::socket_type::dealer)
+{
+  if (endpoint.compare(0, SHM_SCHEME.size(), SHM_SCHEME) == 0)
+    return std::make_unique<shm_transport>(endpoint.substr(SHM_SCHEME.size()), bind);
+  return std::make_unique<zmq_transport>(context, endpoint, bind, type);
+}
+//---------------------------------------------------------------------
+// Transmitter whose endpoint may be any scheme make_transport() accepts
+class transport_transmitter : public IPCTransmitterInterface
+{
+public:
+  transport_transmitter(zmq::context_t&    context,
+                        const std::string& endpoint,
+                        zmq::socket_type   type = zmq::socket_type::dealer)
+  : m_transport(make_transport(context, endpoint, false, type))
+  {}
+
+protected:
+  zmq::socket_t& socket() override
+  {
+    if (auto* transport = dynamic_cast<zmq_transport*>(m_transport.get()))
+      return transport->socket();
+    throw std::runtime_error("Transport has no zmq socket");
+  }
+//--------------------
+  void on_done() override {}
+//--------------------
+  size_t send_frames(std::vector<ipc_message::byte_buffer>&& frames) override
+  {
+    return m_transport->send(frames);
+  }
+
+private:
+  std::unique_ptr<ipc_transport> m_transport;
+};
+} // ns kiq
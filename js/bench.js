@@ -0,0 +1,86 @@
+// Verifies js/kproto.js against the C++ golden vectors (js/golden.json, produced by kproto_golden),
+// then benchmarks the codec against the previous string based implementation.
+//
+// Usage: node js/bench.js [iterations]
+const assert = require('assert')
+const path   = require('path')
+const kproto = require('./kproto')
+const golden = require(path.join(__dirname, 'golden.json'))
+
+const iterations = parseInt(process.argv[2] || '200000', 10)
+//---------------------------------------------------------------------------------------------------------------
+function verify()
+{
+  for (const vector of golden)
+  {
+    const frames = kproto.encode[vector.encoder](...vector.args)
+    assert.deepStrictEqual(frames.map(f => f.toString('hex')), vector.frames, `${vector.encoder}: encoded frames differ`)
+
+    const decoded = kproto.decode(vector.frames.map(hex => Buffer.from(hex, 'hex')))
+    assert.ok(decoded, `${vector.encoder}: failed to decode`)
+    assert.strictEqual(decoded.type, vector.type, `${vector.encoder}: decoded type differs`)
+  }
+
+  const info = golden.find(v => v.encoder === 'info')
+  assert.strictEqual(kproto.deserialize(info.frames.map(hex => Buffer.from(hex, 'hex'))), 'summary, with comma')
+  const status  = golden.find(v => v.encoder === 'status' && v.args.length)
+  const metrics = kproto.decode(status.frames.map(hex => Buffer.from(hex, 'hex'))).metrics
+  assert.strictEqual(metrics.queue_depth, 5)
+  assert.deepStrictEqual(metrics.platforms, [{ name: 'telegram', messages_in: 10, bytes_in: 4096, messages_out: 12, bytes_out: 8192 }])
+  console.log(`Verified ${golden.length} golden vectors`)
+}
+//---------------------------------------------------------------------------------------------------------------
+// The implementation replaced by the Buffer codec, kept here as the baseline
+const encoder = new TextEncoder()
+function legacy_create(type, payload, platform, id = '')
+{
+  let data = []
+  const processor = { "info"      : function() { data = ["", kproto.constants.IPC_PLATFORM_INFO, platform, id, payload, type] },
+                      "keepalive" : function() { data = ["", kproto.constants.IPC_KEEPALIVE_TYPE, ""] } }
+  processor[type](payload)
+  const frames = []
+  for (const part of data)
+    frames.push(encoder.encode((typeof part === 'number') ? String.fromCharCode(part) : part))
+  return frames
+}
+//---------------------------------------------------------------------------------------------------------------
+function legacy_deserialize(data)
+{
+  const type = data[1].charCodeAt(0)
+  if (type === kproto.constants.IPC_PLATFORM_INFO)
+    return data[4].replaceAll('%2C', ',')
+  return data[3]
+}
+//---------------------------------------------------------------------------------------------------------------
+function bench(name, fn)
+{
+  for (let i = 0; i < 1000; i++) fn(i)
+  const start = process.hrtime.bigint()
+  for (let i = 0; i < iterations; i++) fn(i)
+  const ns = Number(process.hrtime.bigint() - start)
+  console.log(`${name.padEnd(36)} ${(iterations / (ns / 1e9)).toFixed(0).padStart(12)} ops/s ${(ns / iterations).toFixed(1).padStart(10)} ns/op`)
+}
+//---------------------------------------------------------------------------------------------------------------
+function main()
+{
+  verify()
+
+  const payload         = 'x'.repeat(4096) + '%2C' + 'y'.repeat(4096)
+  const payload_buffer  = Buffer.from(payload)
+  const info_frames     = kproto.encode.info('kai', payload_buffer, 'generate', '1')
+  const message_frames  = kproto.encode.platform('youtube', '1', 'user', payload_buffer, 'a>b', true, 3, '', '1700000000')
+  let   sink            = 0
+
+  bench('legacy encode info (8KB)',          i => { sink += legacy_create('info', payload, 'kai', '1').length })
+  bench('encode info (8KB string)',          i => { sink += kproto.kproto('info', payload, 'kai', '1').length })
+  bench('encode info (8KB Buffer)',          i => { sink += kproto.encode.info('kai', payload_buffer, 'generate', '1').length })
+  bench('legacy encode keepalive',           i => { sink += legacy_create('keepalive').length })
+  bench('encode keepalive',                  i => { sink += kproto.encode.keepalive().length })
+  bench('encode platform_message (8KB)',     i => { sink += kproto.encode.platform('youtube', '1', 'user', payload_buffer, 'a>b', true, i).length })
+  bench('legacy deserialize info (8KB)',     i => { sink += legacy_deserialize(info_frames.map(f => f.toString())).length })
+  bench('deserialize info (8KB)',            i => { sink += kproto.deserialize(info_frames).length })
+  bench('decode platform_message (8KB)',     i => { sink += kproto.decode(message_frames).cmd })
+  return sink
+}
+
+main()
@@ -1,5 +1,3 @@
-const fs = require('fs')
-
 const IPC_OK_TYPE          = 0x00
 const IPC_KEEPALIVE_TYPE   = 0x01
 const IPC_KIQ_MESSAGE      = 0x02
@@ -9,44 +7,226 @@ const IPC_PLATFORM_REQUEST = 0x05
 const IPC_PLATFORM_INFO    = 0x06
 const IPC_FAIL_TYPE        = 0x07
 const IPC_STATUS           = 0x08
-const encoder              = new TextEncoder()
+const IPC_TASK_TYPE        = 0x09
+const IPC_BLOB_ACK         = 0x0A
+const IPC_BLOB_REQUEST     = 0x0B
+const IPC_BLOB_DATA        = 0x0C
+const IPC_STREAM_CHUNK     = 0x0D
+const IPC_TASK_LOG         = 0x0E
+//---------------------------------------------------------------------------------------------------------------
+// Frames which never change are allocated once and shared by every message
+const EMPTY_FRAME          = Buffer.alloc(0)
+const TYPE_FRAMES          = Array.from({ length: 256 }, (_, type) => Buffer.from([type]))
+const REPOST_FRAMES        = [Buffer.from([0x00]), Buffer.from([0x01])]
+const STREAM_EOS           = 0x01
+const METRICS_VERSION      = 0x01
+const FLAG_FRAMES          = [Buffer.from([0x00]), Buffer.from([STREAM_EOS])]
+const KIQ_NAME             = Buffer.from('KIQ')
+const COMMA                = 0x2C
+const ESCAPED_COMMA        = Buffer.from('%2C')
+//---------------------------------------------------------------------------------------------------------------
+function bytes(value)
+{
+  if (Buffer.isBuffer(value))
+    return value
+  if (value instanceof Uint8Array)
+    return Buffer.from(value.buffer, value.byteOffset, value.byteLength)
+  return (value === undefined || value === null || value === '') ? EMPTY_FRAME : Buffer.from(String(value))
+}
+//---------------------------------------------------------------------------------------------------------------
+function u32_frame(value)
+{
+  const frame = Buffer.allocUnsafe(4)
+  frame.writeUInt32BE(value >>> 0, 0)
+  return frame
+}
+//---------------------------------------------------------------------------------------------------------------
+function u64_frame(value)
+{
+  const frame = Buffer.allocUnsafe(8)
+  frame.writeBigUInt64BE(BigInt(value), 0)
+  return frame
+}
 //---------------------------------------------------------------------------------------------------------------
+// Content hashes (16 bytes) and metrics snapshots are Buffers, or the same as hex digits
+function hash_bytes(hash)
+{
+  return (typeof hash === 'string') ? Buffer.from(hash, 'hex') : bytes(hash)
+}
 //---------------------------------------------------------------------------------------------------------------
+function hash_list(frame)
+{
+  const hashes = []
+  for (let i = 0; i + 16 <= frame.length; i += 16)
+    hashes.push(frame.subarray(i, i + 16))
+  return hashes
+}
+//---------------------------------------------------------------------------------------------------------------
+// Metrics snapshot carried by a status_check reply (layout in kproto/metrics.hpp). Counters are returned as
+// Numbers, exact up to 2^53.
+function decode_metrics(frame)
+{
+  if (frame.length < 27 || frame[0] !== METRICS_VERSION)
+    return null
+
+  let pos       = 1
+  const u16     = () => { const value = frame.readUInt16BE(pos); pos += 2; return value }
+  const u64     = () => { const value = Number(frame.readBigUInt64BE(pos)); pos += 8; return value }
+  const i64     = () => { const value = Number(frame.readBigInt64BE(pos)); pos += 8; return value }
+  const traffic = () => ({ messages_in: u64(), bytes_in: u64(), messages_out: u64(), bytes_out: u64() })
+  const metrics = { decode_failures: u64(), evictions: u64(), queue_depth: i64(), types: [], platforms: [] }
+
+  for (let count = u16(); count > 0; count--)
+    metrics.types.push({ type: frame[pos++], ...traffic() })
+  for (let count = u16(); count > 0; count--)
+  {
+    const size = frame[pos++]
+    const name = frame.toString('utf8', pos, pos + size)
+    pos += size
+    metrics.platforms.push({ name, ...traffic() })
+  }
+  return metrics
+}
+//---------------------------------------------------------------------------------------------------------------
+// Encoders take the same arguments, in the same order, as the C++ constructors in ipc.hpp
+const encode =
+{
+  ok        : (platform = '', id = '')                  => [EMPTY_FRAME, TYPE_FRAMES[IPC_OK_TYPE],          bytes(platform), bytes(id)],
+  fail      : (platform = '', id = '')                  => [EMPTY_FRAME, TYPE_FRAMES[IPC_FAIL_TYPE],        bytes(platform), bytes(id)],
+  keepalive : ()                                        => [EMPTY_FRAME, TYPE_FRAMES[IPC_KEEPALIVE_TYPE]],
+  status    : (snapshot)                                => (snapshot === undefined) ?
+                                                           [EMPTY_FRAME, TYPE_FRAMES[IPC_STATUS]] :
+                                                           [EMPTY_FRAME, TYPE_FRAMES[IPC_STATUS],           hash_bytes(snapshot)],
+  kiq       : (payload, platform = '')                  => [EMPTY_FRAME, TYPE_FRAMES[IPC_KIQ_MESSAGE],      bytes(platform), bytes(payload)],
+  error     : (name, id, user, error)                   => [EMPTY_FRAME, TYPE_FRAMES[IPC_PLATFORM_ERROR],   bytes(name),     bytes(id),
+                                                            bytes(user), bytes(error)],
+  request   : (platform, id, user, data, args)          => [EMPTY_FRAME, TYPE_FRAMES[IPC_PLATFORM_REQUEST], bytes(platform), bytes(id),
+                                                            bytes(user), bytes(data), bytes(args)],
+  info      : (platform, info, type, id)                => [EMPTY_FRAME, TYPE_FRAMES[IPC_PLATFORM_INFO],    bytes(platform), bytes(id),
+                                                            bytes(info), bytes(type)],
+  task      : (id, desc, type, tech, logs)              => [EMPTY_FRAME, TYPE_FRAMES[IPC_TASK_TYPE],        KIQ_NAME,        bytes(id),
+                                                            bytes(desc), bytes(type), bytes(tech), bytes(logs)],
+  platform  : (platform, id, user, content, urls, repost = false, cmd = 0, args = '', time = '') =>
+                                                           [EMPTY_FRAME, TYPE_FRAMES[IPC_PLATFORM_TYPE],    bytes(platform), bytes(id),
+                                                            bytes(user), bytes(content), bytes(urls), REPOST_FRAMES[repost ? 1 : 0],
+                                                            bytes(args), u32_frame(cmd), bytes(time)],
+  blob_ack     : (hashes)                               => [EMPTY_FRAME, TYPE_FRAMES[IPC_BLOB_ACK],         Buffer.concat(hashes.map(hash_bytes))],
+  blob_request : (hashes)                               => [EMPTY_FRAME, TYPE_FRAMES[IPC_BLOB_REQUEST],     Buffer.concat(hashes.map(hash_bytes))],
+  blob_data    : (hash, body = '')                      => [EMPTY_FRAME, TYPE_FRAMES[IPC_BLOB_DATA],        hash_bytes(hash), bytes(body)],
+  stream       : (platform, id, type, seq, delta, eos = false) =>
+                                                           [EMPTY_FRAME, TYPE_FRAMES[IPC_STREAM_CHUNK],     bytes(platform), bytes(id),
+                                                            bytes(type), u32_frame(seq), FLAG_FRAMES[eos ? 1 : 0], bytes(delta)],
+  task_log     : (id, offset, chunk)                    => [EMPTY_FRAME, TYPE_FRAMES[IPC_TASK_LOG],         KIQ_NAME,        bytes(id),
+                                                            u64_frame(offset), bytes(chunk)]
+}
+//---------------------------------------------------------------------------------------------------------------
+// Decoded fields are views onto the received frames; nothing is copied or converted to strings
+const DECODERS = new Array(256).fill(null)
+DECODERS[IPC_OK_TYPE]          = f => ({ type: IPC_OK_TYPE,          platform: f[2], id: f[3] })
+DECODERS[IPC_FAIL_TYPE]        = f => ({ type: IPC_FAIL_TYPE,        platform: f[2], id: f[3] })
+DECODERS[IPC_KEEPALIVE_TYPE]   = f => ({ type: IPC_KEEPALIVE_TYPE })
+DECODERS[IPC_STATUS]           = f => ({ type: IPC_STATUS,           metrics: (f.length > 2) ? decode_metrics(f[2]) : null })
+DECODERS[IPC_KIQ_MESSAGE]      = f => ({ type: IPC_KIQ_MESSAGE,      platform: f[2], payload: f[3] })
+DECODERS[IPC_PLATFORM_ERROR]   = f => ({ type: IPC_PLATFORM_ERROR,   platform: f[2], id: f[3], user: f[4], error: f[5] })
+DECODERS[IPC_PLATFORM_REQUEST] = f => ({ type: IPC_PLATFORM_REQUEST, platform: f[2], id: f[3], user: f[4], content: f[5],
+                                         args: f[6] })
+DECODERS[IPC_PLATFORM_INFO]    = f => ({ type: IPC_PLATFORM_INFO,    platform: f[2], id: f[3], info: f[4], info_type: f[5] })
+DECODERS[IPC_TASK_TYPE]        = f => ({ type: IPC_TASK_TYPE,        platform: f[2], id: f[3], description: f[4],
+                                         task_type: f[5], tech: f[6], logs: f[7] })
+DECODERS[IPC_PLATFORM_TYPE]    = f => ({ type: IPC_PLATFORM_TYPE,    platform: f[2], id: f[3], user: f[4], content: f[5],
+                                         urls: f[6], repost: f[7][0] !== 0x00, args: f[8], cmd: f[9].readUInt32BE(0),
+                                         time: f[10] })
+DECODERS[IPC_BLOB_ACK]         = f => ({ type: IPC_BLOB_ACK,         hashes: hash_list(f[2]) })
+DECODERS[IPC_BLOB_REQUEST]     = f => ({ type: IPC_BLOB_REQUEST,     hashes: hash_list(f[2]) })
+DECODERS[IPC_BLOB_DATA]        = f => ({ type: IPC_BLOB_DATA,        hash: f[2], body: f[3] })
+DECODERS[IPC_STREAM_CHUNK]     = f => ({ type: IPC_STREAM_CHUNK,     platform: f[2], id: f[3], stream_type: f[4],
+                                         seq: f[5].readUInt32BE(0), eos: (f[6][0] & STREAM_EOS) !== 0, delta: f[7] })
+DECODERS[IPC_TASK_LOG]         = f => ({ type: IPC_TASK_LOG,         platform: f[2], id: f[3],
+                                         offset: Number(f[4].readBigUInt64BE(0)), chunk: f[5] })
+//---------------------------------------------------------------------------------------------------------------
+function decode(data)
+{
+  const frames  = data.map(bytes)
+  const decoder = DECODERS[frames[1][0]]
+  return (decoder) ? decoder(frames) : null
+}
+//---------------------------------------------------------------------------------------------------------------
+// Replace every '%2C' with ',' by compacting the buffer in place
+function unescape_commas(buffer)
+{
+  let match = buffer.indexOf(ESCAPED_COMMA)
+  if (match === -1)
+    return buffer
+
+  let write = match
+  while (match !== -1)
+  {
+    buffer[write++] = COMMA
+    const read = match + ESCAPED_COMMA.length
+          match = buffer.indexOf(ESCAPED_COMMA, read)
+    const end   = (match === -1) ? buffer.length : match
+    buffer.copyWithin(write, read, end)
+    write += end - read
+  }
+  return buffer.subarray(0, write)
+}
+//---------------------------------------------------------------------------------------------------------------
+const INFO_TYPES = new Set(['loadurl', 'analysis', 'generate', 'info'])
 function create_ipc_message(type, payload, platform, id = '')
 {
-  const frames = []
-  let   data   = []
+  if (INFO_TYPES.has(type))
+    return encode.info(platform, payload, type, id)
 
-  const processor = { "loadurl"   : function() { data = ["", IPC_PLATFORM_INFO, platform, id, payload, type  ] },
-                      "analysis"  : function() { data = ["", IPC_PLATFORM_INFO, platform, id, payload, type  ] },
-                      "generate"  : function() { data = ["", IPC_PLATFORM_INFO, platform, id, payload, type  ] },
-                      "ok"        : function() { data = ["", IPC_OK_TYPE,                                  ""] },
-                      "keepalive" : function() { data = ["", IPC_KEEPALIVE_TYPE,                           ""] },
-                      "kiq"       : function() { data = ["", IPC_KIQ_MESSAGE,                              ""] },
-                      "platform"  : function() { data = ["", IPC_PLATFORM_TYPE,                            ""] },
-                      "error"     : function() { data = ["", IPC_PLATFORM_ERROR,                           ""] },
-                      "request"   : function() { data = ["", IPC_PLATFORM_REQUEST,                         ""] },
-                      "info"      : function() { data = ["", IPC_PLATFORM_INFO, platform, id, payload, type  ] },
-                      "fail"      : function() { data = ["", IPC_FAIL_TYPE,                                ""] },
-                      "status"    : function() { data = ["", IPC_STATUS,                                   ""] }}
+  switch (type)
+  {
+    case 'ok'        : return encode.ok       (platform, id)
+    case 'fail'      : return encode.fail     (platform, id)
+    case 'keepalive' : return encode.keepalive()
+    case 'status'    : return encode.status   ()
+    case 'kiq'       : return encode.kiq      (payload, platform)
+    case 'platform'  : return encode.platform (platform, id, '', payload, '')
+    case 'error'     : return encode.error    (platform, id, '', payload)
+    case 'request'   : return encode.request  (platform, id, '', payload, '')
+  }
+  throw new Error(`Unknown IPC message type: ${type}`)
+}
+//---------------------------------------------------------------------------------------------------------------
+// Decode straight from the frame, emitting ',' between the segments around each '%2C'
+function unescaped_string(buffer)
+{
+  let match = buffer.indexOf(ESCAPED_COMMA)
+  if (match === -1)
+    return buffer.toString()
 
-  processor[type](payload)
-  for (const part of data)
-    frames.push(encoder.encode((typeof part === 'number') ?
-                                String.fromCharCode(part) : part))
-  return frames
+  let text = ''
+  let read = 0
+  while (match !== -1)
+  {
+    text += buffer.toString('utf8', read, match) + ','
+    read  = match + ESCAPED_COMMA.length
+    match = buffer.indexOf(ESCAPED_COMMA, read)
+  }
+  return text + buffer.toString('utf8', read)
 }
 //---------------------------------------------------------------------------------------------------------------
 function deserialize_ipc(data)
 {
-  const type = data[1].charCodeAt(0)
+  const type = bytes(data[1])[0]
   if (type === IPC_PLATFORM_INFO)
-    return data[4].replaceAll('%2C', ',')
+    return unescaped_string(bytes(data[4]))
 
-  return data[3]
+  return bytes(data[3]).toString()
 }
 //---------------------------------------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------------------------------------
-module.exports.kproto      = create_ipc_message
-module.exports.default     = create_ipc_message
-module.exports.deserialize = deserialize_ipc
\ No newline at end of file
+module.exports.kproto          = create_ipc_message
+module.exports.default         = create_ipc_message
+module.exports.deserialize     = deserialize_ipc
+module.exports.encode          = encode
+module.exports.decode          = decode
+module.exports.unescape_commas = unescape_commas
+module.exports.decode_metrics  = decode_metrics
+module.exports.constants       = { IPC_OK_TYPE, IPC_KEEPALIVE_TYPE, IPC_KIQ_MESSAGE, IPC_PLATFORM_TYPE, IPC_PLATFORM_ERROR,
+                                   IPC_PLATFORM_REQUEST, IPC_PLATFORM_INFO, IPC_FAIL_TYPE, IPC_STATUS, IPC_TASK_TYPE,
+                                   IPC_BLOB_ACK, IPC_BLOB_REQUEST, IPC_BLOB_DATA, IPC_STREAM_CHUNK, IPC_TASK_LOG,
+                                   STREAM_EOS }
@@ -0,0 +1,141 @@
+#include <kproto/transport.hpp>
+#include <kproto/threading.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include "stats.hpp"
+
+using namespace kiq;
+using namespace kiq::tools;
+
+// Round-trip latency between two worker threads ping-ponging a
+// platform_message, first with placement left to the OS, then with both
+// threads and the context's IO thread pinned (and optionally SCHED_FIFO).
+static void usage()
+{
+  std::cout << "Usage: kproto_bench_affinity [options]\n"
+               "  --cpus <a,b>       CPUs for the ping and echo threads (default: first two of node 0)\n"
+               "  --io-cpus <list>   CPUs for the ZeroMQ IO thread (default: --cpus)\n"
+               "  --rt <priority>    SCHED_FIFO priority in the pinned run (default: 0, off)\n"
+               "  --scheme <name>    inproc, ipc or shm (default: ipc)\n"
+               "  --size <bytes>     payload size (default: 256)\n"
+               "  --pings <n>        round trips per run (default: 50000)\n";
+}
+//---------------------------------------------------------------------
+struct options
+{
+std::vector<int> cpus;
+std::vector<int> io_cpus;
+int              rt_priority{0};
+std::string      scheme{"ipc"};
+size_t           size{256};
+size_t           pings{50000};
+};
+//---------------------------------------------------------------------
+static bool parse(int argc, char** argv, options& opts)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string_view arg{argv[i]};
+    if (i + 1 >= argc)
+      return false;
+    const char* value = argv[++i];
+    if      (arg == "--cpus")    opts.cpus        = threading::parse_cpulist(value);
+    else if (arg == "--io-cpus") opts.io_cpus     = threading::parse_cpulist(value);
+    else if (arg == "--rt")      opts.rt_priority = std::atoi(value);
+    else if (arg == "--scheme")  opts.scheme      = value;
+    else if (arg == "--size")    opts.size        = std::strtoul(value, nullptr, 10);
+    else if (arg == "--pings")   opts.pings       = std::strtoul(value, nullptr, 10);
+    else
+      return false;
+  }
+
+  if (opts.cpus.empty())
+    opts.cpus = threading::node_cpus(0);
+  if (opts.cpus.empty())
+    opts.cpus = {0};
+  if (opts.cpus.size() == 1)
+    opts.cpus.push_back(opts.cpus.front());
+  opts.cpus.resize(2);
+  if (opts.io_cpus.empty())
+    opts.io_cpus = opts.cpus;
+  return opts.pings;
+}
+//---------------------------------------------------------------------
+static std::string endpoint(const std::string& scheme, const char* name)
+{
+  const auto id = std::to_string(::getpid()) + '-' + name;
+  if (scheme == "ipc") return "ipc:///tmp/kproto-bench-" + id;
+  if (scheme == "shm") return "shm://bench-" + id;
+  return "inproc://bench-" + id;
+}
+//---------------------------------------------------------------------
+static void run(const options& opts, bool pinned, const char* label)
+{
+  thread_config ping, echo;
+  io_config     io;
+  if (pinned)
+  {
+    ping.cpus        = {opts.cpus[0]};
+    echo.cpus        = {opts.cpus[1]};
+    io.cpus          = opts.io_cpus;
+    ping.rt_priority = echo.rt_priority = io.rt_priority = opts.rt_priority;
+  }
+  ping.name = "kp-ping";
+  echo.name = "kp-echo";
+
+  zmq::context_t context;
+  threading::configure(context, io);
+
+  const auto ping_address = endpoint(opts.scheme, "ping");
+  const auto pong_address = endpoint(opts.scheme, "pong");
+  auto       ping_rx      = make_transport(context, ping_address, true,  zmq::socket_type::pull);
+  auto       pong_rx      = make_transport(context, pong_address, true,  zmq::socket_type::pull);
+  auto       ping_tx      = make_transport(context, ping_address, false, zmq::socket_type::push);
+  auto       pong_tx      = make_transport(context, pong_address, false, zmq::socket_type::push);
+  const auto frames       = platform_message("bench", "1", "user", std::string(opts.size, 'x'), "").data();
+
+  std::thread echo_thread = threading::spawn(echo, [&] {
+    std::vector<ipc_message::byte_buffer> received;
+    for (size_t i = 0; i < opts.pings && ping_rx->recv(received, std::chrono::seconds(5)); i++)
+      pong_tx->send(received);
+  });
+
+  latency_stats stats;
+  std::thread ping_thread = threading::spawn(ping, [&] {
+    std::vector<ipc_message::byte_buffer> received;
+    for (size_t i = 0; i < opts.pings; i++)
+    {
+      const auto start = steady_clock::now();
+      ping_tx->send(frames);
+      if (!pong_rx->recv(received, std::chrono::seconds(5)))
+        break;
+      stats.add(elapsed_ns(start));
+    }
+  });
+  ping_thread.join();
+  echo_thread.join();
+
+  stats.print(label);
+}
+//---------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  options opts;
+  if (!parse(argc, argv, opts))
+  {
+    usage();
+    return 1;
+  }
+
+  threading::set_log_fn([](const char* message) { std::fprintf(stderr, "%s\n", message); });
+  std::printf("%s, %zu B, %zu pings; ping on CPU %d, echo on CPU %d, %u CPUs online%s\n", opts.scheme.c_str(),
+              opts.size, opts.pings, opts.cpus[0], opts.cpus[1], std::thread::hardware_concurrency(),
+              (opts.rt_priority) ? ", SCHED_FIFO" : "");
+  run(opts, false, "unpinned");
+  run(opts, true,  "pinned");
+  return 0;
+}
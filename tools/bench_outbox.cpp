@@ -0,0 +1,156 @@
+#include <kproto/outbox.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdlib.h>
+#include <string_view>
+#include <thread>
+#include "stats.hpp"
+
+using namespace kiq;
+using namespace kiq::tools;
+
+// Sends platform_messages over inproc:// to a sink that acks each one, first
+// without an outbox, then logging through outbox_log::tap() and finally also
+// waiting for durability every --batch messages (group commit). Each run logs
+// to its own subdirectory of a fresh directory made under --path, and only
+// that fresh directory is removed at exit.
+static void usage()
+{
+  std::cout << "Usage: kproto_bench_outbox [options]\n"
+               "  --path <dir>       parent of the scratch outbox directory (default: /tmp)\n"
+               "  --messages <n>     messages per run (default: 200000)\n"
+               "  --size <bytes>     payload size (default: 1024)\n"
+               "  --batch <n>        messages per wait_durable() in the synced run (default: 256)\n";
+}
+//---------------------------------------------------------------------
+struct options
+{
+std::string path{"/tmp"};
+size_t      messages{200000};
+size_t      size{1024};
+size_t      batch{256};
+};
+//---------------------------------------------------------------------
+static bool parse(int argc, char** argv, options& opts)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string_view arg{argv[i]};
+    if (i + 1 >= argc)
+      return false;
+    const char* value = argv[++i];
+    if      (arg == "--path")     opts.path     = value;
+    else if (arg == "--messages") opts.messages = std::strtoul(value, nullptr, 10);
+    else if (arg == "--size")     opts.size     = std::strtoul(value, nullptr, 10);
+    else if (arg == "--batch")    opts.batch    = std::strtoul(value, nullptr, 10);
+    else
+      return false;
+  }
+  return opts.messages && opts.batch;
+}
+//---------------------------------------------------------------------
+class push_transmitter : public IPCTransmitterInterface
+{
+public:
+  push_transmitter(zmq::context_t& context, const std::string& endpoint)
+  : m_socket(context, zmq::socket_type::push)
+  {
+    m_socket.connect(endpoint);
+  }
+
+protected:
+  zmq::socket_t& socket() override
+  {
+    return m_socket;
+  }
+//--------------------
+  void on_done() override {}
+
+private:
+  zmq::socket_t m_socket;
+};
+//---------------------------------------------------------------------
+enum class mode
+{
+  memory,
+  logged,
+  synced
+};
+//---------------------------------------------------------------------
+static void run(zmq::context_t& context, const options& opts, const std::string& scratch, mode run_mode,
+                const char* label)
+{
+  const auto    endpoint = "inproc://bench-outbox-" + std::string{label};
+  outbox_config config;
+  config.path = scratch + '/' + label;
+  auto log    = (run_mode == mode::memory) ? nullptr : std::make_unique<outbox_log>(config);
+
+  zmq::socket_t sink(context, zmq::socket_type::pull);
+  sink.bind(endpoint);
+  push_transmitter transmitter(context, endpoint);
+  if (log)
+    transmitter.set_tap(log->tap());
+
+  std::thread receiver([&] {
+    zmq::message_t message;
+    std::string    platform, id;
+    for (size_t n = 0; n < opts.messages;)
+    {
+      size_t part = 0;
+      do
+      {
+        if (!sink.recv(message, zmq::recv_flags::none))
+          return;
+        if (part == constants::index::PLATFORM)
+          platform.assign(static_cast<const char*>(message.data()), message.size());
+        else if (part == constants::index::ID)
+          id.assign(static_cast<const char*>(message.data()), message.size());
+        part++;
+      }
+      while (message.more());
+      if (log)
+        log->ack(platform, id);
+      n++;
+    }
+  });
+
+  const std::string payload(opts.size, 'x');
+  const auto        start = steady_clock::now();
+  for (size_t i = 0; i < opts.messages; i++)
+  {
+    transmitter.send_ipc_message(std::make_unique<platform_message>("bench", std::to_string(i), "user", payload, ""));
+    if (run_mode == mode::synced && (i + 1) % opts.batch == 0)
+      log->sync();
+  }
+  receiver.join();
+  const double seconds = elapsed_ns(start) / 1e9;
+
+  std::printf("%-8s %10.0f msg/s  %9.1f MB/s  pending %zu\n", label, opts.messages / seconds,
+              opts.messages * opts.size / seconds / (1024 * 1024), (log) ? log->pending() : 0);
+}
+//---------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  options opts;
+  if (!parse(argc, argv, opts))
+  {
+    usage();
+    return 1;
+  }
+
+  std::string scratch = opts.path + "/kproto-bench-outbox-XXXXXX";
+  if (!::mkdtemp(scratch.data()))
+  {
+    std::perror(("kproto_bench_outbox: cannot create a directory under " + opts.path).c_str());
+    return 1;
+  }
+
+  zmq::context_t context{1};
+  std::printf("%zu messages of %zu bytes in %s\n", opts.messages, opts.size, scratch.c_str());
+  run(context, opts, scratch, mode::memory, "memory");
+  run(context, opts, scratch, mode::logged, "logged");
+  run(context, opts, scratch, mode::synced, "synced");
+  std::filesystem::remove_all(scratch);
+  return 0;
+}
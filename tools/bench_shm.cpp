@@ -0,0 +1,151 @@
+#include <kproto/transport.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include "stats.hpp"
+
+using namespace kiq;
+using namespace kiq::tools;
+
+// Compares the shm:// ring against zmq inproc:// and ipc:// through the same
+// ipc_transport interface: one-way throughput, then round-trip latency between
+// two threads ping-ponging a platform_message.
+static void usage()
+{
+  std::cout << "Usage: kproto_bench_shm [options]\n"
+               "  --sizes <list>     payload sizes (default: 64,1024,65536)\n"
+               "  --messages <n>     messages per throughput run (default: 200000)\n"
+               "  --pings <n>        round trips per latency run (default: 20000)\n"
+               "  --schemes <list>   any of inproc,ipc,shm (default: all)\n";
+}
+//---------------------------------------------------------------------
+struct options
+{
+std::vector<size_t>      sizes{64, 1024, 65536};
+std::vector<std::string> schemes{"inproc", "ipc", "shm"};
+size_t                   messages{200000};
+size_t                   pings{20000};
+};
+//---------------------------------------------------------------------
+static std::vector<std::string> split(const char* value)
+{
+  std::vector<std::string> items;
+  std::stringstream        ss{value};
+  std::string              item;
+  while (std::getline(ss, item, ','))
+    items.push_back(item);
+  return items;
+}
+//---------------------------------------------------------------------
+static bool parse(int argc, char** argv, options& opts)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string_view arg{argv[i]};
+    if (i + 1 >= argc)
+      return false;
+    const char* value = argv[++i];
+    if      (arg == "--messages") opts.messages = std::strtoul(value, nullptr, 10);
+    else if (arg == "--pings")    opts.pings    = std::strtoul(value, nullptr, 10);
+    else if (arg == "--schemes")  opts.schemes  = split(value);
+    else if (arg == "--sizes")
+    {
+      opts.sizes.clear();
+      for (const auto& item : split(value))
+        opts.sizes.push_back(std::strtoul(item.c_str(), nullptr, 10));
+    }
+    else
+      return false;
+  }
+  return !opts.sizes.empty() && !opts.schemes.empty();
+}
+//---------------------------------------------------------------------
+static std::string endpoint(const std::string& scheme, const char* name)
+{
+  const auto id = std::to_string(::getpid()) + '-' + name;
+  if (scheme == "ipc") return "ipc:///tmp/kproto-bench-" + id;
+  if (scheme == "shm") return "shm://bench-" + id;
+  return "inproc://bench-" + id;
+}
+//---------------------------------------------------------------------
+static void throughput(zmq::context_t& context, const std::string& scheme, size_t size, size_t count)
+{
+  const auto address  = endpoint(scheme, "tput");
+  auto       receiver = make_transport(context, address, true,  zmq::socket_type::pull);
+  auto       sender   = make_transport(context, address, false, zmq::socket_type::push);
+  const auto frames   = platform_message("bench", "1", "user", std::string(size, 'x'), "").data();
+
+  steady_clock::time_point start;
+  std::thread producer([&] {
+    start = steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+      sender->send(frames);
+  });
+
+  std::vector<ipc_message::byte_buffer> received;
+  size_t                                n = 0;
+  while (n < count && receiver->recv(received, std::chrono::seconds(5)))
+    n++;
+  const double seconds = elapsed_ns(start) / 1e9;
+  producer.join();
+
+  std::printf("%-7s %8zu B  %10.0f msg/s  %9.1f MB/s%s\n", scheme.c_str(), size, n / seconds,
+              n * size / seconds / (1024 * 1024), (n < count) ? "  (timed out)" : "");
+}
+//---------------------------------------------------------------------
+static void latency(zmq::context_t& context, const std::string& scheme, size_t size, size_t count)
+{
+  const auto ping_address = endpoint(scheme, "ping");
+  const auto pong_address = endpoint(scheme, "pong");
+  auto       ping_rx      = make_transport(context, ping_address, true,  zmq::socket_type::pull);
+  auto       pong_rx      = make_transport(context, pong_address, true,  zmq::socket_type::pull);
+  auto       ping_tx      = make_transport(context, ping_address, false, zmq::socket_type::push);
+  auto       pong_tx      = make_transport(context, pong_address, false, zmq::socket_type::push);
+  const auto frames       = platform_message("bench", "1", "user", std::string(size, 'x'), "").data();
+
+  std::thread echo([&] {
+    std::vector<ipc_message::byte_buffer> received;
+    for (size_t i = 0; i < count && ping_rx->recv(received, std::chrono::seconds(5)); i++)
+      pong_tx->send(received);
+  });
+
+  latency_stats                         stats;
+  std::vector<ipc_message::byte_buffer> received;
+  for (size_t i = 0; i < count; i++)
+  {
+    const auto start = steady_clock::now();
+    ping_tx->send(frames);
+    if (!pong_rx->recv(received, std::chrono::seconds(5)))
+      break;
+    stats.add(elapsed_ns(start));
+  }
+  echo.join();
+
+  const auto label = scheme + ' ' + std::to_string(size);
+  stats.print(label.c_str());
+}
+//---------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  options opts;
+  if (!parse(argc, argv, opts))
+  {
+    usage();
+    return 1;
+  }
+
+  zmq::context_t context{1};
+  std::printf("Throughput (%zu messages)\n", opts.messages);
+  for (const auto size : opts.sizes)
+    for (const auto& scheme : opts.schemes)
+      throughput(context, scheme, size, opts.messages);
+
+  std::printf("\nRound trip (%zu pings)\n", opts.pings);
+  for (const auto size : opts.sizes)
+    for (const auto& scheme : opts.schemes)
+      latency(context, scheme, size, opts.pings);
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include <kproto/striped_transmitter.hpp>
+#include <zmq_addon.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include "stats.hpp"
+
+using namespace kiq;
+using namespace kiq::tools;
+
+// Measures delivered bandwidth of striped_transmitter as the socket count grows.
+// Each stripe is received by its own ROUTER sink thread, so the receive side does
+// not become the bottleneck being measured.
+static void usage()
+{
+  std::cout << "Usage: kproto_bench_stripes [options]\n"
+               "  --sockets <list>   socket counts to compare (default: 1,2,4,8)\n"
+               "  --producers <n>    sending threads (default: 8)\n"
+               "  --size <bytes>     platform_message payload size (default: 1048576)\n"
+               "  --seconds <s>      duration of each run (default: 2)\n";
+}
+//---------------------------------------------------------------------
+struct options
+{
+std::vector<size_t> sockets{1, 2, 4, 8};
+int                 producers{8};
+size_t              size{1024 * 1024};
+double              seconds{2};
+};
+//---------------------------------------------------------------------
+static bool parse(int argc, char** argv, options& opts)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string_view arg{argv[i]};
+    if (i + 1 >= argc)
+      return false;
+    const char* value = argv[++i];
+    if      (arg == "--producers") opts.producers = std::max(1, std::atoi(value));
+    else if (arg == "--size")      opts.size      = std::strtoul(value, nullptr, 10);
+    else if (arg == "--seconds")   opts.seconds   = std::atof(value);
+    else if (arg == "--sockets")
+    {
+      opts.sockets.clear();
+      std::stringstream ss{value};
+      std::string       item;
+      while (std::getline(ss, item, ','))
+        opts.sockets.push_back(std::max(1, std::atoi(item.c_str())));
+    }
+    else
+      return false;
+  }
+  return !opts.sockets.empty();
+}
+//---------------------------------------------------------------------
+static void run(const options& opts, size_t sockets)
+{
+  static const int  hwm = 16;
+  zmq::context_t    sink_context{static_cast<int>(sockets)};
+  std::atomic<bool> stop{false};
+  std::atomic<bool> stop_sinks{false};
+  std::atomic<bool> measuring{false};
+  std::vector<std::unique_ptr<zmq::socket_t>> sinks;
+  std::vector<std::string>                    endpoints;
+  std::vector<std::thread>                    sink_threads;
+  std::vector<size_t>                         received(sockets, 0);
+
+  for (size_t i = 0; i < sockets; i++)
+  {
+    auto& sink = sinks.emplace_back(std::make_unique<zmq::socket_t>(sink_context, zmq::socket_type::router));
+    sink->set(zmq::sockopt::linger, 0);
+    sink->set(zmq::sockopt::rcvhwm, hwm);
+    sink->set(zmq::sockopt::affinity, uint64_t{1} << (i % 64));
+    sink->bind("tcp://127.0.0.1:*");
+    endpoints.push_back(sink->get(zmq::sockopt::last_endpoint));
+  }
+
+  for (size_t i = 0; i < sockets; i++)
+    sink_threads.emplace_back([&, i] {
+      auto&           sink = *sinks[i];
+      zmq::pollitem_t item{sink.handle(), 0, ZMQ_POLLIN, 0};
+      while (!stop_sinks)
+      {
+        if (!zmq::poll(&item, 1, std::chrono::milliseconds(20)))
+          continue;
+        std::vector<zmq::message_t> parts;
+        while (zmq::recv_multipart(sink, std::back_inserter(parts), zmq::recv_flags::dontwait))
+        {
+          if (measuring)
+            for (const auto& part : parts)
+              received[i] += part.size();
+          parts.clear();
+        }
+      }
+    });
+
+  striped_transmitter transmitter{endpoints, sockets, static_cast<int>(sockets), zmq::socket_type::dealer,
+                                  [](zmq::socket_t& socket) { socket.set(zmq::sockopt::sndhwm, hwm); }};
+  const std::string   payload(opts.size, 'x');
+  std::vector<std::thread> producers;
+  for (int p = 0; p < opts.producers; p++)
+    producers.emplace_back([&, p] {
+      for (size_t n = 0; !stop; n++)
+      {
+        const auto platform = "platform-" + std::to_string((p * 31 + n) % 64);
+        transmitter.send_ipc_message(std::make_unique<platform_message>(platform, std::to_string(n), "bench", payload, ""));
+      }
+    });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+  measuring = true;
+  const auto start = steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int64_t>(opts.seconds * 1000)));
+  measuring = false;
+  const double elapsed = elapsed_ns(start) / 1e9;
+  stop = true;
+
+  for (auto& t : producers)    t.join();
+  stop_sinks = true;
+  for (auto& t : sink_threads) t.join();
+
+  size_t bytes = 0;
+  for (const auto b : received)
+    bytes += b;
+
+  const auto stats = transmitter.metrics();
+  std::string spread;
+  for (const auto& stripe : stats.stripes)
+    spread += std::to_string(stripe.messages) + ' ';
+  std::printf("sockets=%-3zu %10.1f MB/s   messages per stripe: %s\n", sockets, bytes / elapsed / (1024 * 1024),
+              spread.c_str());
+}
+//---------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  options opts;
+  if (!parse(argc, argv, opts))
+  {
+    usage();
+    return 1;
+  }
+
+  std::printf("%d producers, %zu byte payloads, tcp loopback\n", opts.producers, opts.size);
+  for (const auto sockets : opts.sockets)
+    run(opts, sockets);
+  return 0;
+}
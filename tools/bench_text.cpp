@@ -0,0 +1,119 @@
+#include <kproto/simd.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include "stats.hpp"
+
+using namespace kiq;
+using namespace kiq::tools;
+
+// Compares the vectorized text helpers in simd.hpp against their scalar versions
+// for frame sizes from 1 KB to 1 MB, checking that both produce the same result.
+static void usage()
+{
+  std::cout << "Usage: kproto_bench_text [options]\n"
+               "  --min <bytes>      smallest frame (default: 1024)\n"
+               "  --max <bytes>      largest frame (default: 1048576)\n"
+               "  --bytes <n>        bytes processed per measurement (default: 268435456)\n";
+}
+//---------------------------------------------------------------------
+struct options
+{
+size_t min{1024};
+size_t max{1024 * 1024};
+size_t bytes{256 * 1024 * 1024};
+};
+//---------------------------------------------------------------------
+static bool parse(int argc, char** argv, options& opts)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string_view arg{argv[i]};
+    if (i + 1 >= argc)
+      return false;
+    const size_t value = std::strtoul(argv[++i], nullptr, 10);
+    if      (arg == "--min")   opts.min   = value;
+    else if (arg == "--max")   opts.max   = value;
+    else if (arg == "--bytes") opts.bytes = value;
+    else
+      return false;
+  }
+  return opts.min && opts.min <= opts.max;
+}
+//---------------------------------------------------------------------
+static std::string repeat(const std::string& unit, size_t size)
+{
+  std::string out;
+  out.reserve(size + unit.size());
+  while (out.size() < size)
+    out += unit;
+  out.resize(size);
+  return out;
+}
+//---------------------------------------------------------------------
+template <typename F>
+static double measure(size_t size, size_t total, F&& fn)
+{
+  const size_t iterations = std::max<size_t>(1, total / size);
+  size_t       sink       = 0;
+  const auto   start      = steady_clock::now();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    asm volatile("" ::: "memory"); // the input may have changed; don't hoist the call out of the loop
+    sink += fn();
+  }
+  const double seconds = elapsed_ns(start) / 1e9;
+  if (sink == 0xFFFFFFFFFFFF) // keep the results live
+    std::puts("");
+  return (iterations * size) / seconds / (1024 * 1024 * 1024);
+}
+//---------------------------------------------------------------------
+static void report(const char* name, size_t size, double scalar, double simd)
+{
+  std::printf("%-16s %8zu B  scalar %7.2f GB/s   simd %7.2f GB/s   x%.1f\n", name, size, scalar, simd, simd / scalar);
+}
+//---------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  options opts;
+  if (!parse(argc, argv, opts))
+  {
+    usage();
+    return 1;
+  }
+
+  for (size_t size = opts.min; size <= opts.max; size *= 4)
+  {
+    const std::string urls    = repeat("https://cdn.example.com/media/2024/05/file-0042.jpg>", size);
+    const std::string escaped = repeat("The analysis found three topics%2C two sentiments and a summary. ", size);
+    std::string       content = repeat("Live stream tonight at 8pm, with guests and Q&A. Живой эфир сегодня. ", size);
+    while (!text::scalar::validate_utf8(content)) // don't end inside a sequence
+      content.pop_back();
+
+    if (text::split_urls(urls) != text::scalar::split_urls(urls))
+      throw std::runtime_error("split_urls mismatch");
+    if (!text::validate_utf8(content) || text::validate_utf8(content + "\xC0\x80"))
+      throw std::runtime_error("validate_utf8 mismatch");
+
+    report("split_urls", size,
+           measure(size, opts.bytes, [&] { return text::scalar::split_urls(urls).size(); }),
+           measure(size, opts.bytes, [&] { return text::split_urls(urls).size(); }));
+    report("validate_utf8", size,
+           measure(size, opts.bytes, [&] { return text::scalar::validate_utf8(content) + size_t{1}; }),
+           measure(size, opts.bytes, [&] { return text::validate_utf8(content) + size_t{1}; }));
+
+    std::string scratch_a = escaped, scratch_b = escaped;
+    if (text::unescape_commas(scratch_a.data(), scratch_a.size()) !=
+        text::scalar::unescape_commas(scratch_b.data(), scratch_b.size()) || scratch_a != scratch_b)
+      throw std::runtime_error("unescape_commas mismatch");
+    // Each pass restores the escaped frame first, so both sides include the same copy
+    report("unescape_commas", size,
+           measure(size, opts.bytes, [&] { std::memcpy(scratch_a.data(), escaped.data(), size);
+                                           return text::scalar::unescape_commas(scratch_a.data(), size); }),
+           measure(size, opts.bytes, [&] { std::memcpy(scratch_b.data(), escaped.data(), size);
+                                           return text::unescape_commas(scratch_b.data(), size); }));
+  }
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include <kproto/blob_cache.hpp>
+#include <kproto/stream.hpp>
+#include <cstdio>
+#include <iostream>
+
+using namespace kiq;
+
+// Prints the golden wire vectors shared with js/kproto.js (js/golden.json).
+// Each vector names the JS encoder, the constructor arguments and the frames
+// produced by the C++ message class.
+//---------------------------------------------------------------------
+static std::string quote(const std::string& s)
+{
+  std::string out{"\""};
+  for (const char c : s)
+  {
+    if (c == '\n')
+      out += "\\n";
+    else
+    {
+      if (c == '"' || c == '\\')
+        out += '\\';
+      out += c;
+    }
+  }
+  return out + '"';
+}
+//---------------------------------------------------------------------
+static std::string hex(const ipc_message::byte_buffer& frame)
+{
+  static const char* digits = "0123456789abcdef";
+  std::string out;
+  for (const uint8_t byte : frame)
+  {
+    out += digits[byte >> 4];
+    out += digits[byte & 0x0F];
+  }
+  return out;
+}
+//---------------------------------------------------------------------
+struct vector_t
+{
+const char*                encoder;
+std::vector<std::string>   args;
+std::vector<std::string>   raw; // non-string arguments, emitted verbatim
+ipc_message::u_ipc_msg_ptr msg;
+};
+//---------------------------------------------------------------------
+int main()
+{
+  std::vector<vector_t> vectors;
+  vectors.push_back({"ok",        {"telegram", "42"}, {}, std::make_unique<okay_message>("telegram", "42")});
+  vectors.push_back({"fail",      {"mastodon", "43"}, {}, std::make_unique<fail_message>("mastodon", "43")});
+  vectors.push_back({"keepalive", {},                 {}, std::make_unique<keepalive>()});
+  vectors.push_back({"status",    {},                 {}, std::make_unique<status_check>()});
+  vectors.push_back({"kiq",       {"{\"command\":\"start\"}", "kai"}, {},
+                     std::make_unique<kiq_message>("{\"command\":\"start\"}", "kai")});
+  vectors.push_back({"error",     {"discord", "44", "logicp", "rate limited"}, {},
+                     std::make_unique<platform_error>("discord", "44", "logicp", "rate limited")});
+  vectors.push_back({"request",   {"kiq", "1234", "logicp", "hello", "{\"key\": \"value\"}"}, {},
+                     std::make_unique<platform_request>("kiq", "1234", "logicp", "hello", "{\"key\": \"value\"}")});
+  vectors.push_back({"info",      {"kai", "summary%2C with comma", "analysis", "45"}, {},
+                     std::make_unique<platform_info>("kai", "summary%2C with comma", "analysis", "45")});
+  vectors.push_back({"task",      {"46", "render", "video", "ffmpeg", "frame=1\nframe=2"}, {},
+                     std::make_unique<task>("46", "render", "video", "ffmpeg", "frame=1\nframe=2")});
+  vectors.push_back({"platform",  {"youtube", "47", "logicp", "Живой эфир", "https://a.b/1>https://a.b/2"},
+                     {"true", "16909060", "\"--live\"", "\"1700000000\""},
+                     std::make_unique<platform_message>("youtube", "47", "logicp", "Живой эфир",
+                                                        "https://a.b/1>https://a.b/2", true, 0x01020304,
+                                                        "--live", "1700000000")});
+
+  const std::string body(64, 'b');
+  const auto        first  = blob::hash_of({body.begin(), body.end()});
+  const auto        second = blob::hash_of({first.begin(), first.end()});
+  const auto        hash_1 = quote(hex({first.begin(),  first.end()}));
+  const auto        hash_2 = quote(hex({second.begin(), second.end()}));
+  vectors.push_back({"blob_ack",     {}, {"[" + hash_1 + ", " + hash_2 + "]"},
+                     std::make_unique<blob_ack>(std::vector<blob_hash>{first, second})});
+  vectors.push_back({"blob_request", {}, {"[" + hash_1 + "]"},
+                     std::make_unique<blob_request>(std::vector<blob_hash>{first})});
+  vectors.push_back({"blob_data",    {}, {hash_1, quote(body)},
+                     std::make_unique<blob_data>(first, ipc_message::byte_buffer{body.begin(), body.end()})});
+  metrics::snapshot stats;
+  stats.decode_failures = 2;
+  stats.evictions       = 1;
+  stats.queue_depth     = 5;
+  stats.types           = {{constants::IPC_PLATFORM_TYPE, {10, 4096, 12, 8192}}};
+  stats.platforms       = {{"telegram", {10, 4096, 12, 8192}}};
+  vectors.push_back({"status",       {hex(metrics::serialize(stats))}, {}, std::make_unique<status_check>(stats)});
+  vectors.push_back({"stream",       {"kai", "48", "generate"}, {"7", quote("Hello, wor"), "true"},
+                     std::make_unique<stream_chunk>("kai", "48", "generate", 7, "Hello, wor", true)});
+  vectors.push_back({"task_log",     {"46"}, {"4294967301", quote("frame=3\n")},
+                     std::make_unique<task_log>("46", 4294967301ULL, "frame=3\n")});
+
+  std::cout << "[\n";
+  for (size_t i = 0; i < vectors.size(); i++)
+  {
+    const auto& v = vectors[i];
+    std::string args, frames;
+    for (const auto& arg : v.args)
+      args += (args.empty() ? "" : ", ") + quote(arg);
+    for (const auto& arg : v.raw)
+      args += (args.empty() ? "" : ", ") + arg;
+    for (const auto& frame : v.msg->m_frames)
+      frames += (frames.empty() ? "" : ", ") + quote(hex(frame));
+
+    std::cout << "  { \"encoder\": " << quote(v.encoder) << ", \"type\": " << static_cast<int>(v.msg->type()) << ",\n"
+              << "    \"args\": [" << args << "],\n"
+              << "    \"frames\": [" << frames << "] }" << ((i == vectors.size() - 1) ? "\n" : ",\n");
+  }
+  std::cout << "]" << std::endl;
+  return 0;
+}
@@ -0,0 +1,339 @@
+#include <kproto/ipc.hpp>
+#include <kproto/ipc_structs.hpp>
+#include <zmq_addon.hpp>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <unistd.h>
+#include "stats.hpp"
+
+using namespace kiq;
+using namespace kiq::tools;
+
+static void usage()
+{
+  std::cout << "Usage: kproto_loadgen [options]\n"
+               "  --clients <n>         simulated platform clients (default: 4)\n"
+               "  --transport <t>       inproc | ipc | tcp (default: inproc)\n"
+               "  --connect <endpoint>  drive an external broker instead of the built-in sink\n"
+               "  --rate <n>            target messages per second across all clients, 0 = unlimited (default: 0)\n"
+               "  --duration <s>        seconds to run (default: 5)\n"
+               "  --mix <spec>          weights, ie: message=70,info=10,keepalive=15,status=5\n"
+               "  --size <min>[:<max>]  payload size range in bytes, uniformly distributed (default: 256)\n"
+               "  --io-threads <n>      ZeroMQ IO threads (default: 1)\n"
+               "Latency and drop counts assume the peer answers every message with an okay_message,\n"
+               "which the built-in sink does.\n";
+}
+//---------------------------------------------------------------------
+enum class kind : uint8_t
+{
+  message,
+  info,
+  keepalive,
+  status
+};
+//---------------------------------------------------------------------
+struct options
+{
+int                   clients{4};
+std::string           transport{"inproc"};
+std::string           endpoint;
+bool                  external{false};
+double                rate{0};
+double                duration{5};
+std::array<double, 4> mix{70, 10, 15, 5};
+size_t                min_size{256};
+size_t                max_size{256};
+int                   io_threads{1};
+};
+//---------------------------------------------------------------------
+static bool parse_mix(std::string_view spec, std::array<double, 4>& mix)
+{
+  mix.fill(0);
+  std::stringstream ss{std::string{spec}};
+  std::string       item;
+  while (std::getline(ss, item, ','))
+  {
+    const auto pos = item.find('=');
+    if (pos == std::string::npos)
+      return false;
+    const auto   name   = item.substr(0, pos);
+    const double weight = std::atof(item.c_str() + pos + 1);
+    if      (name == "message"   || name == "platform_message") mix[static_cast<int>(kind::message)]   = weight;
+    else if (name == "info"      || name == "platform_info")    mix[static_cast<int>(kind::info)]      = weight;
+    else if (name == "keepalive")                               mix[static_cast<int>(kind::keepalive)] = weight;
+    else if (name == "status"    || name == "status_check")     mix[static_cast<int>(kind::status)]    = weight;
+    else
+      return false;
+  }
+  return true;
+}
+//---------------------------------------------------------------------
+static bool parse(int argc, char** argv, options& opts)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string_view arg{argv[i]};
+    if (i + 1 >= argc)
+      return false;
+    const char* value = argv[++i];
+    if      (arg == "--clients")    opts.clients    = std::max(1, std::atoi(value));
+    else if (arg == "--transport")  opts.transport  = value;
+    else if (arg == "--rate")       opts.rate       = std::atof(value);
+    else if (arg == "--duration")   opts.duration   = std::atof(value);
+    else if (arg == "--io-threads") opts.io_threads = std::max(1, std::atoi(value));
+    else if (arg == "--connect")
+    {
+      opts.endpoint = value;
+      opts.external = true;
+    }
+    else if (arg == "--mix")
+    {
+      if (!parse_mix(value, opts.mix))
+        return false;
+    }
+    else if (arg == "--size")
+    {
+      const std::string_view size{value};
+      const auto             pos = size.find(':');
+      opts.min_size = std::strtoul(value, nullptr, 10);
+      opts.max_size = (pos == std::string_view::npos) ? opts.min_size : std::strtoul(value + pos + 1, nullptr, 10);
+      if (opts.max_size < opts.min_size)
+        return false;
+    }
+    else
+      return false;
+  }
+
+  if (!opts.external)
+  {
+    if      (opts.transport == "inproc") opts.endpoint = "inproc://kproto_loadgen";
+    else if (opts.transport == "ipc")    opts.endpoint = "ipc:///tmp/kproto_loadgen_" + std::to_string(::getpid());
+    else if (opts.transport == "tcp")    opts.endpoint = "tcp://127.0.0.1:*";
+    else
+      return false;
+  }
+  return true;
+}
+//---------------------------------------------------------------------
+class sink
+{
+public:
+  sink(zmq::context_t& context, const std::string& endpoint)
+  : m_socket(context, zmq::socket_type::router)
+  {
+    m_socket.set(zmq::sockopt::linger, 0);
+    m_socket.bind(endpoint);
+  }
+//--------------------
+  std::string endpoint() const
+  {
+    return m_socket.get(zmq::sockopt::last_endpoint);
+  }
+//--------------------
+  void run(const std::atomic<bool>& stop)
+  {
+    zmq::pollitem_t item{m_socket.handle(), 0, ZMQ_POLLIN, 0};
+    while (!stop)
+    {
+      if (!zmq::poll(&item, 1, std::chrono::milliseconds(50)))
+        continue;
+
+      std::vector<zmq::message_t> parts;
+      while (zmq::recv_multipart(m_socket, std::back_inserter(parts), zmq::recv_flags::dontwait))
+      {
+        std::vector<ipc_message::byte_buffer> frames;
+        for (auto it = parts.begin() + 1; it != parts.end(); it++)
+          frames.emplace_back(it->data<uint8_t>(), it->data<uint8_t>() + it->size());
+
+        auto msg = DeserializeIPCMessage(std::move(frames));
+        if (!msg)
+          m_failed++;
+
+        const okay_message reply{};
+        m_socket.send(parts.front(), zmq::send_flags::sndmore);
+        for (size_t i = 0; i < reply.m_frames.size(); i++)
+        {
+          const auto& frame = reply.m_frames[i];
+          const auto  flag  = (i == reply.m_frames.size() - 1) ? zmq::send_flags::none : zmq::send_flags::sndmore;
+          m_socket.send(zmq::message_t{frame.data(), frame.size()}, flag);
+        }
+        m_received++;
+        parts.clear();
+      }
+    }
+  }
+//--------------------
+  size_t received() const { return m_received; }
+  size_t failed()   const { return m_failed;   }
+
+private:
+  zmq::socket_t m_socket;
+  size_t        m_received{0};
+  size_t        m_failed{0};
+};
+//---------------------------------------------------------------------
+class client : public IPCTransmitterInterface
+{
+public:
+  client(zmq::context_t& context, const std::string& endpoint, int num, const options& opts)
+  : m_socket(context, zmq::socket_type::dealer),
+    m_platform("loadgen-" + std::to_string(num)),
+    m_opts(opts),
+    m_rng(num),
+    m_kind(opts.mix.begin(), opts.mix.end()),
+    m_size(opts.min_size, opts.max_size)
+  {
+    m_socket.set(zmq::sockopt::linger, 0);
+    m_socket.connect(endpoint);
+  }
+//--------------------
+  void run(steady_clock::time_point end)
+  {
+    const auto interval = (m_opts.rate > 0) ?
+      std::chrono::nanoseconds(static_cast<int64_t>(1e9 * m_opts.clients / m_opts.rate)) : std::chrono::nanoseconds{0};
+    auto       next     = steady_clock::now();
+
+    while (steady_clock::now() < end)
+    {
+      if (interval.count())
+      {
+        std::this_thread::sleep_until(next);
+        next += interval;
+      }
+      m_pending.push_back(steady_clock::now());
+      send_ipc_message(make_message());
+      m_sent++;
+      drain(zmq::recv_flags::dontwait);
+    }
+
+    const auto deadline = steady_clock::now() + std::chrono::seconds(1);
+    while (!m_pending.empty() && steady_clock::now() < deadline)
+    {
+      zmq::pollitem_t item{m_socket.handle(), 0, ZMQ_POLLIN, 0};
+      if (zmq::poll(&item, 1, std::chrono::milliseconds(50)))
+        drain(zmq::recv_flags::dontwait);
+    }
+  }
+//--------------------
+  size_t         sent()    const { return m_sent;           }
+  size_t         dropped() const { return m_pending.size(); }
+  size_t         bytes()   const { return m_bytes;          }
+  latency_stats& latency()       { return m_latency;        }
+
+protected:
+  zmq::socket_t& socket() override { return m_socket; }
+  void           on_done() override {}
+
+private:
+  ipc_message::u_ipc_msg_ptr make_message()
+  {
+    const auto id = std::to_string(m_sent);
+    switch (static_cast<kind>(m_kind(m_rng)))
+    {
+      case (kind::message):
+      {
+        const std::string payload(m_size(m_rng), 'x');
+        m_bytes += payload.size();
+        return std::make_unique<platform_message>(m_platform, id, "loadgen", payload, "");
+      }
+      case (kind::info):
+      {
+        const std::string payload(m_size(m_rng), 'x');
+        m_bytes += payload.size();
+        return std::make_unique<platform_info>(m_platform, payload, REQUEST_GENERATE_AI, id);
+      }
+      case (kind::keepalive): return std::make_unique<keepalive>();
+      default:                return std::make_unique<status_check>();
+    }
+  }
+//--------------------
+  void drain(zmq::recv_flags flags)
+  {
+    std::vector<zmq::message_t> parts;
+    while (!m_pending.empty() && zmq::recv_multipart(m_socket, std::back_inserter(parts), flags))
+    {
+      m_latency.add(elapsed_ns(m_pending.front()));
+      m_pending.pop_front();
+      parts.clear();
+    }
+  }
+
+  using pending_t = std::deque<steady_clock::time_point>;
+
+  zmq::socket_t                         m_socket;
+  std::string                           m_platform;
+  const options&                        m_opts;
+  std::mt19937                          m_rng;
+  std::discrete_distribution<int>       m_kind;
+  std::uniform_int_distribution<size_t> m_size;
+  pending_t                             m_pending;
+  latency_stats                         m_latency;
+  size_t                                m_sent{0};
+  size_t                                m_bytes{0};
+};
+//---------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  options opts;
+  if (!parse(argc, argv, opts))
+  {
+    usage();
+    return 1;
+  }
+
+  zmq::context_t        context{opts.io_threads};
+  std::unique_ptr<sink> server;
+  std::thread           server_thread;
+  std::atomic<bool>     stop{false};
+
+  if (!opts.external)
+  {
+    server        = std::make_unique<sink>(context, opts.endpoint);
+    opts.endpoint = server->endpoint();
+    server_thread = std::thread([&] { server->run(stop); });
+  }
+
+  std::vector<std::unique_ptr<client>> clients;
+  std::vector<std::thread>             threads;
+  for (int i = 0; i < opts.clients; i++)
+    clients.emplace_back(std::make_unique<client>(context, opts.endpoint, i, opts));
+
+  const auto start = steady_clock::now();
+  const auto end   = start + std::chrono::milliseconds(static_cast<int64_t>(opts.duration * 1000));
+  for (auto& c : clients)
+    threads.emplace_back([&c, end] { c->run(end); });
+  for (auto& t : threads)
+    t.join();
+  const double seconds = elapsed_ns(start) / 1e9;
+
+  stop = true;
+  if (server_thread.joinable())
+    server_thread.join();
+
+  size_t        sent = 0, dropped = 0, bytes = 0;
+  latency_stats latency;
+  for (auto& c : clients)
+  {
+    sent    += c->sent();
+    dropped += c->dropped();
+    bytes   += c->bytes();
+    latency.merge(c->latency());
+  }
+
+  std::printf("Endpoint %s, %d clients, %.2fs\n", opts.endpoint.c_str(), opts.clients, seconds);
+  std::printf("Sent %zu messages (%zu payload bytes): %.0f msg/s, %.2f MB/s (target %s)\n", sent, bytes,
+              sent / seconds, bytes / seconds / (1024 * 1024),
+              (opts.rate > 0) ? std::to_string(static_cast<int64_t>(opts.rate)).c_str() : "unlimited");
+  std::printf("Dropped %zu messages\n", dropped);
+  if (server)
+    std::printf("Sink received %zu messages, %zu failed to decode\n", server->received(), server->failed());
+  latency.print("rtt");
+  return 0;
+}
@@ -0,0 +1,70 @@
+#include <kproto/stream.hpp>
+#include <cstdio>
+
+using namespace kiq;
+
+// Feeds DeserializeIPCMessage messages a misbehaving peer could send and
+// checks that each is rejected as a decode failure rather than decoded into
+// a message whose accessors read past its frames. Exits non-zero on failure.
+//---------------------------------------------------------------------
+static int failures = 0;
+//---------------------------------------------------------------------
+static void check(bool passed, const char* what)
+{
+  std::printf("%s  %s\n", (passed) ? "PASS" : "FAIL", what);
+  if (!passed)
+    failures++;
+}
+//---------------------------------------------------------------------
+static uint64_t decode_failures()
+{
+  return metrics::registry::instance().read().decode_failures;
+}
+//---------------------------------------------------------------------
+// Whether frames are refused and counted as one decode failure
+static bool rejected(std::vector<ipc_message::byte_buffer> frames)
+{
+  const uint64_t before = decode_failures();
+  return !DeserializeIPCMessage(std::move(frames)) && decode_failures() == before + 1;
+}
+//---------------------------------------------------------------------
+int main()
+{
+  auto chunk = stream_chunk("bench", "1", "generate", 0, "delta", true).data();
+  {
+    auto message = DeserializeIPCMessage(std::vector<ipc_message::byte_buffer>{chunk});
+    auto decoded = dynamic_cast<stream_chunk*>(message.get());
+    check(decoded && decoded->seq() == 0 && decoded->eos(), "a well-formed stream_chunk decodes");
+
+    stream_assembler assembler;
+    check(decoded && assembler.add(*decoded), "stream_assembler completes a stream from it");
+  }
+
+  auto empty_seq = chunk;
+  empty_seq[constants::index::SEQ].clear();
+  check(rejected(empty_seq), "a stream_chunk with an empty seq frame is a decode failure");
+
+  auto long_seq = chunk;
+  long_seq[constants::index::SEQ].push_back(0x00);
+  check(rejected(long_seq), "a stream_chunk with a 5-byte seq frame is a decode failure");
+
+  chunk.resize(constants::index::SEQ);
+  check(rejected(chunk), "a stream_chunk missing frames is a decode failure");
+
+  auto log = task_log("1", 42, "output").data();
+  {
+    auto message = DeserializeIPCMessage(std::vector<ipc_message::byte_buffer>{log});
+    auto decoded = dynamic_cast<task_log*>(message.get());
+    check(decoded && decoded->offset() == 42, "a well-formed task_log decodes");
+  }
+
+  auto short_offset = log;
+  short_offset[constants::index::OFFSET].resize(4);
+  check(rejected(short_offset), "a task_log with a 4-byte offset frame is a decode failure");
+
+  auto empty_offset = log;
+  empty_offset[constants::index::OFFSET].clear();
+  check(rejected(empty_offset), "a task_log with an empty offset frame is a decode failure");
+
+  return (failures) ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+#include <kproto/capture.hpp>
+#include <zmq_addon.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include "stats.hpp"
+
+using namespace kiq;
+using namespace kiq::tools;
+
+static void usage()
+{
+  std::cout << "Usage: kproto_replay <capture file> <endpoint> [options]\n"
+               "  --max                 replay as fast as possible (default: original timing)\n"
+               "  --bind                bind the endpoint instead of connecting to it\n"
+               "  --sink                receive on a local ROUTER at <endpoint> and report delivery latency\n"
+               "  --dir <in|out|all>    captured direction to replay (default: all)\n"
+               "  --loop <n>            replay the capture n times (default: 1)\n";
+}
+//---------------------------------------------------------------------
+struct options
+{
+std::string capture;
+std::string endpoint;
+bool        max_speed{false};
+bool        bind{false};
+bool        sink{false};
+int         dir{-1};
+int         loops{1};
+};
+//---------------------------------------------------------------------
+static bool parse(int argc, char** argv, options& opts)
+{
+  if (argc < 3)
+    return false;
+
+  opts.capture  = argv[1];
+  opts.endpoint = argv[2];
+  for (int i = 3; i < argc; i++)
+  {
+    const std::string_view arg{argv[i]};
+    if      (arg == "--max")  opts.max_speed = true;
+    else if (arg == "--bind") opts.bind      = true;
+    else if (arg == "--sink") opts.sink      = true;
+    else if (arg == "--dir"  && i + 1 < argc)
+    {
+      const std::string_view dir{argv[++i]};
+      opts.dir = (dir == "in") ? static_cast<int>(capture::direction::in)  :
+                 (dir == "out") ? static_cast<int>(capture::direction::out) : -1;
+    }
+    else if (arg == "--loop" && i + 1 < argc)
+      opts.loops = std::max(1, std::atoi(argv[++i]));
+    else
+      return false;
+  }
+  return !(opts.sink && opts.bind);
+}
+//---------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  options opts;
+  if (!parse(argc, argv, opts))
+  {
+    usage();
+    return 1;
+  }
+
+  capture_reader              reader{opts.capture};
+  zmq::context_t              context{1};
+  zmq::socket_t               socket{context, zmq::socket_type::dealer};
+  zmq::socket_t               sink_socket;
+  std::vector<uint64_t>       sent_at;
+  std::atomic<size_t>         sent{0};
+  latency_stats               delivery;
+  std::thread                 sink_thread;
+  const auto                  start = steady_clock::now();
+
+  socket.set(zmq::sockopt::linger, 0);
+  socket.set(zmq::sockopt::sndhwm, 0);
+
+  if (opts.sink)
+  {
+    size_t records = 0;
+    capture_record record;
+    while (reader.next(record))
+      if (opts.dir < 0 || static_cast<int>(record.dir) == opts.dir)
+        records++;
+    reader.rewind();
+    sent_at.resize(records * opts.loops);
+
+    sink_socket = zmq::socket_t{context, zmq::socket_type::router};
+    sink_socket.set(zmq::sockopt::rcvhwm, 0);
+    sink_socket.bind(opts.endpoint);
+    sink_thread = std::thread([&] {
+      size_t received = 0, failed = 0;
+      while (received < sent_at.size())
+      {
+        std::vector<zmq::message_t> parts;
+        if (!zmq::recv_multipart(sink_socket, std::back_inserter(parts)))
+          continue;
+        const uint64_t now = elapsed_ns(start);
+
+        std::vector<ipc_message::byte_buffer> frames;
+        for (auto it = parts.begin() + 1; it != parts.end(); it++)
+          frames.emplace_back(it->data<uint8_t>(), it->data<uint8_t>() + it->size());
+        try
+        {
+          if (!DeserializeIPCMessage(std::move(frames), true))
+            failed++;
+        }
+        catch (const std::exception&)
+        {
+          failed++;
+        }
+
+        while (received >= sent.load(std::memory_order_acquire))
+          std::this_thread::yield();
+        delivery.add(now - sent_at[received++]);
+      }
+      if (failed)
+        std::cout << "Sink failed to decode " << failed << " messages" << std::endl;
+    });
+  }
+
+  if (opts.bind)
+    socket.bind(opts.endpoint);
+  else
+    socket.connect(opts.endpoint);
+
+  latency_stats  send_latency;
+  latency_stats  schedule_lag;
+  size_t         messages = 0;
+  size_t         bytes    = 0;
+  capture_record record;
+
+  for (int loop = 0; loop < opts.loops; loop++)
+  {
+    reader.rewind();
+    uint64_t   first_ts    = 0;
+    const auto loop_start  = steady_clock::now();
+    while (reader.next(record))
+    {
+      if (opts.dir >= 0 && static_cast<int>(record.dir) != opts.dir)
+        continue;
+
+      if (!first_ts)
+        first_ts = record.timestamp;
+
+      if (!opts.max_speed)
+      {
+        const auto due = loop_start + std::chrono::nanoseconds(record.timestamp - first_ts);
+        std::this_thread::sleep_until(due);
+        schedule_lag.add(elapsed_ns(due));
+      }
+
+      const auto send_start = steady_clock::now();
+      if (opts.sink)
+        sent_at[messages] = elapsed_ns(start, send_start);
+
+      for (size_t i = 0; i < record.frames.size(); i++)
+      {
+        const auto& frame = record.frames[i];
+        const auto  flag  = (i == record.frames.size() - 1) ? zmq::send_flags::none : zmq::send_flags::sndmore;
+        socket.send(zmq::message_t{frame.data(), frame.size()}, flag);
+        bytes += frame.size();
+      }
+      if (opts.sink)
+        sent.store(messages + 1, std::memory_order_release);
+      send_latency.add(elapsed_ns(send_start));
+      messages++;
+    }
+  }
+
+  if (sink_thread.joinable())
+    sink_thread.join();
+
+  const double seconds = elapsed_ns(start) / 1e9;
+  std::printf("Replayed %zu messages (%zu bytes) in %.3fs: %.0f msg/s, %.2f MB/s\n",
+              messages, bytes, seconds, messages / seconds, bytes / seconds / (1024 * 1024));
+  send_latency.print("send");
+  if (!opts.max_speed)
+    schedule_lag.print("lag");
+  if (opts.sink)
+    delivery.print("delivery");
+  return 0;
+}
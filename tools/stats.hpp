@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace kiq::tools {
+using steady_clock = std::chrono::steady_clock;
+//---------------------------------------------------------------------
+inline uint64_t elapsed_ns(steady_clock::time_point start, steady_clock::time_point end = steady_clock::now())
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+//---------------------------------------------------------------------
+class latency_stats
+{
+public:
+  void add(uint64_t ns)
+  {
+    m_samples.push_back(ns);
+  }
+//--------------------
+  void merge(const latency_stats& other)
+  {
+    m_samples.insert(m_samples.end(), other.m_samples.begin(), other.m_samples.end());
+  }
+//--------------------
+  size_t count() const
+  {
+    return m_samples.size();
+  }
+//--------------------
+  uint64_t percentile(double p)
+  {
+    if (m_samples.empty())
+      return 0;
+    const size_t n = std::min(m_samples.size() - 1, static_cast<size_t>(p / 100.0 * m_samples.size()));
+    std::nth_element(m_samples.begin(), m_samples.begin() + n, m_samples.end());
+    return m_samples[n];
+  }
+//--------------------
+  void print(const char* label)
+  {
+    std::printf("%-12s n=%-10zu p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n", label, count(),
+                percentile(50) / 1e3, percentile(90) / 1e3, percentile(99) / 1e3, percentile(99.9) / 1e3,
+                percentile(100) / 1e3);
+  }
+
+private:
+  std::vector<uint64_t> m_samples;
+};
+} // ns kiq::tools
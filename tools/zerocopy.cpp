@@ -0,0 +1,86 @@
+#include <kproto/ipc.hpp>
+#include <cstdio>
+
+using namespace kiq;
+
+// Verifies that a payload moved into a message reaches zmq without being
+// copied: the buffer handed to the constructor must be the very memory the
+// receiving inproc socket sees (zmq passes zmq_msg_init_data messages through
+// inproc pipes by reference). Exits non-zero on failure.
+//
+// Only the send path is zero-copy. Receiving copies each frame out of its
+// zmq::message_t into a byte_buffer once, before DeserializeIPCMessage.
+//---------------------------------------------------------------------
+class push_transmitter : public IPCTransmitterInterface
+{
+public:
+  push_transmitter(zmq::context_t& context, const std::string& endpoint)
+  : m_socket(context, zmq::socket_type::push)
+  {
+    m_socket.connect(endpoint);
+  }
+
+protected:
+  zmq::socket_t& socket() override
+  {
+    return m_socket;
+  }
+//--------------------
+  void on_done() override {}
+
+private:
+  zmq::socket_t m_socket;
+};
+//---------------------------------------------------------------------
+static int failures = 0;
+//---------------------------------------------------------------------
+static void check(bool passed, const char* what)
+{
+  std::printf("%s  %s\n", (passed) ? "PASS" : "FAIL", what);
+  if (!passed)
+    failures++;
+}
+//---------------------------------------------------------------------
+// Sends a platform_message whose content is size bytes; returns whether the receiver saw the original buffer
+static bool sent_in_place(zmq::context_t& context, zmq::socket_t& sink, const std::string& endpoint, size_t size,
+                          bool& constructed_in_place)
+{
+  push_transmitter         transmitter(context, endpoint);
+  ipc_message::byte_buffer content(size, 'x');
+  const uint8_t*           original = content.data();
+
+  auto message = std::make_unique<platform_message>("bench", "1", "user", std::move(content), "");
+  constructed_in_place = message->m_frames.at(constants::index::DATA).data() == original;
+  transmitter.send_ipc_message(std::move(message));
+
+  zmq::message_t frame;
+  const void*    received = nullptr;
+  size_t         part     = 0;
+  do
+  {
+    if (!sink.recv(frame, zmq::recv_flags::none))
+      return false;
+    if (part++ == constants::index::DATA)
+      received = frame.data();
+  }
+  while (frame.more());
+  return received == original;
+}
+//---------------------------------------------------------------------
+int main()
+{
+  const std::string endpoint{"inproc://kproto-zerocopy"};
+  zmq::context_t    context{1};
+  zmq::socket_t     sink(context, zmq::socket_type::pull);
+  sink.bind(endpoint);
+
+  bool constructed = false;
+  const bool large = sent_in_place(context, sink, endpoint, 1024 * 1024, constructed);
+  check(constructed, "platform_message keeps a moved-in 1 MB payload buffer");
+  check(large,       "send_ipc_message hands the 1 MB payload to zmq without copying");
+
+  const bool small = sent_in_place(context, sink, endpoint, ZERO_COPY_MIN / 2, constructed);
+  check(!small, "payloads under ZERO_COPY_MIN are copied into the zmq message");
+
+  return (failures) ? 1 : 0;
+}